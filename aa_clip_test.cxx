@@ -0,0 +1,271 @@
+/*
+	Headless test of the rasterizers of contrib/bresenham*.c (no FLTK,
+	no display needed):
+
+	- For random primitives and clip rectangles the pixel calls of the
+	  clipped variant inside the clip rectangle must be the same (in the
+	  same order, with the same alpha) as those of the unclipped algorithm.
+	- The functions unchanged since the original bresenham code must
+	  give golden/baseline.pgm (coverage of a fixed scene), which was
+	  rendered by the original functions of the baseline commit, not by
+	  the current ones:
+
+	    mkdir -p /tmp/base/contrib && cp aa_clip_test.cxx /tmp/base
+	    git show 54f95d2:contrib/bresenham.c >/tmp/base/contrib/bresenham.c
+	    git show 54f95d2:contrib/bresenham_ext.c >/tmp/base/contrib/bresenham_ext.c
+	    g++ -DAA_BASELINE -o /tmp/base/write /tmp/base/aa_clip_test.cxx
+	    /tmp/base/write
+
+	Usage: aa_clip_test [cases per primitive]
+	(make test runs it)
+*/
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <vector>
+
+struct Call
+{
+	int x, y, alpha;
+	bool operator==( const Call &c_ ) const { return x == c_.x && y == c_.y && alpha == c_.alpha; }
+};
+static std::vector<Call> Calls;	// recorded pixel calls
+
+static void setPixelAA( int x, int y, unsigned char alpha )
+{
+	Call c = { x, y, alpha };
+	Calls.push_back( c );
+}
+
+static void setPixel( int x, int y )
+{
+	setPixelAA( x, y, 0 );
+}
+
+static void setHLine( int x0, int x1, int y )
+{
+	for ( int x = x0; x <= x1; x++ )
+		setPixelAA( x, y, 0 );
+}
+
+#include "contrib/bresenham.c"
+#include "contrib/bresenham_ext.c"
+
+static const int W = 240;
+static const int H = 240;
+static const char *Baseline = "golden/baseline.pgm";
+
+static void baseline_scene()
+{
+	// functions unchanged since the baseline (each drawn separately)
+	plotLineAA( 10, 10, 230, 60 );
+	plotLineAA( 10, 10, 60, 230 );
+	plotLineAA( 230, 10, 10, 30 );
+	plotLineAA( 5, 235, 235, 200 );
+	plotLineWidth( 20, 230, 220, 100, 4 );
+	plotLineWidth( 200, 20, 40, 200, 1.5 );
+	plotCircleAA( 120, 120, 50 );
+	plotCircleAA( 40, 40, 17 );
+	plotEllipseRectAA( 20, 80, 220, 160 );
+	plotEllipseRectAA( 150, 20, 231, 57 );
+	plotQuadBezierSegAA( 10, 230, 60, 130, 120, 100 );
+	plotQuadRationalBezierSegAA( 20, 20, 100, 20, 100, 100, .5 );
+	plotCubicBezierSegAA( 130, 230, 160, 200, 200, 190, 230, 130 );
+	plotFilledCircle( 60, 180, 25 );
+	plotFilledEllipse( 180, 40, 30, 12 );
+	plotFilledEllipseRect( 140, 160, 230, 230 );
+}
+
+static std::vector<unsigned char> baseline_image()
+{
+	// coverage of the scene (maximum of the pixel calls)
+	Calls.clear();
+	baseline_scene();
+	std::vector<unsigned char> img( W * H );
+	for ( size_t i = 0; i < Calls.size(); i++ )
+	{
+		const Call &p = Calls[i];
+		if ( p.x >= 0 && p.y >= 0 && p.x < W && p.y < H )
+			img[p.y * W + p.x] = std::max( img[p.y * W + p.x], (unsigned char)( 255 - p.alpha ) );
+	}
+	return img;
+}
+
+#ifdef AA_BASELINE
+// (compiled with the baseline functions: write the reference image)
+int main()
+{
+	std::vector<unsigned char> img = baseline_image();
+	FILE *f = fopen( Baseline, "wb" );
+	if ( !f )
+		return 1;
+	fprintf( f, "P5\n%d %d\n255\n", W, H );
+	bool ok = fwrite( &img[0], 1, img.size(), f ) == img.size();
+	return fclose( f ) == 0 && ok ? 0 : 1;
+}
+#else
+static int check_baseline()
+{
+	std::vector<unsigned char> img = baseline_image(), ref( W * H );
+	FILE *f = fopen( Baseline, "rb" );
+	int w = 0, h = 0, max = 0;
+	bool ok = f && fscanf( f, "P5 %d %d %d", &w, &h, &max ) == 3 && w == W && h == H &&
+	          max == 255 && fgetc( f ) != EOF && fread( &ref[0], 1, ref.size(), f ) == ref.size();
+	if ( f )
+		fclose( f );
+	if ( !ok )
+	{
+		printf( "can't read %s\n", Baseline );
+		return 1;
+	}
+	int bad = 0;
+	for ( int i = 0; i < W * H; i++ )
+		bad += img[i] != ref[i];
+	printf( "%-14s %d pixels differ from the baseline\n", "baseline", bad );
+	return bad != 0;
+}
+
+struct Case
+{
+	int x0, y0, x1, y1;	// line/ellipse rectangle, circle center and radius
+	float wd;
+	int cx0, cy0, cx1, cy1;	// clip rectangle (inclusive)
+};
+
+// the unclipped and the clipped variant of a primitive
+typedef void ( *Draw )( const Case &c_, bool clip_ );
+
+static void line( const Case &c_, bool clip_ )
+{
+	if ( clip_ )
+		plotLineAAClip( c_.x0, c_.y0, c_.x1, c_.y1, c_.cx0, c_.cy0, c_.cx1, c_.cy1 );
+	else
+		plotLineAA( c_.x0, c_.y0, c_.x1, c_.y1 );
+}
+
+static void line_width( const Case &c_, bool clip_ )
+{
+	if ( clip_ )
+		plotLineWidthClip( c_.x0, c_.y0, c_.x1, c_.y1, c_.wd, c_.cx0, c_.cy0, c_.cx1, c_.cy1 );
+	else
+		plotLineWidth( c_.x0, c_.y0, c_.x1, c_.y1, c_.wd );
+}
+
+static void circle( const Case &c_, bool clip_ )
+{
+	int r = abs( c_.x1 - c_.x0 ) / 2;
+	if ( clip_ )
+		plotCircleAAClip( c_.x0, c_.y0, r, c_.cx0, c_.cy0, c_.cx1, c_.cy1 );
+	else
+		plotCircleAA( c_.x0, c_.y0, r );
+}
+
+static void ellipse( const Case &c_, bool clip_ )
+{
+	if ( clip_ )
+		plotEllipseRectAAClip( c_.x0, c_.y0, c_.x1, c_.y1, c_.cx0, c_.cy0, c_.cx1, c_.cy1 );
+	else
+		plotEllipseRectAA( c_.x0, c_.y0, c_.x1, c_.y1 );
+}
+
+static void filled_circle( const Case &c_, bool clip_ )
+{
+	int r = abs( c_.x1 - c_.x0 ) / 2;
+	if ( clip_ )
+		plotFilledCircleAAClip( c_.x0, c_.y0, r, c_.cx0, c_.cy0, c_.cx1, c_.cy1 );
+	else
+		plotFilledCircleAA( c_.x0, c_.y0, r );
+}
+
+static void filled_ellipse( const Case &c_, bool clip_ )
+{
+	if ( clip_ )
+		plotFilledEllipseRectAAClip( c_.x0, c_.y0, c_.x1, c_.y1, c_.cx0, c_.cy0, c_.cx1, c_.cy1 );
+	else
+		plotFilledEllipseRectAA( c_.x0, c_.y0, c_.x1, c_.y1 );
+}
+
+// pixel calls of a primitive inside the clip rectangle
+static std::vector<Call> calls( Draw draw_, const Case &c_, bool clip_ )
+{
+	Calls.clear();
+	draw_( c_, clip_ );
+	std::vector<Call> v;
+	for ( size_t i = 0; i < Calls.size(); i++ )
+	{
+		const Call &p = Calls[i];
+		if ( p.x >= c_.cx0 && p.x <= c_.cx1 && p.y >= c_.cy0 && p.y <= c_.cy1 )
+			v.push_back( p );
+	}
+	return v;
+}
+
+static int check( const char *name_, Draw draw_, const Case &c_ )
+{
+	std::vector<Call> a = calls( draw_, c_, false );
+	std::vector<Call> b = calls( draw_, c_, true );
+	if ( a == b )
+		return 0;
+	size_t i = 0;
+	while ( i < a.size() && i < b.size() && a[i] == b[i] )
+		i++;
+	printf( "%s (%d,%d)-(%d,%d) w %g clip (%d,%d)-(%d,%d): ", name_,
+	        c_.x0, c_.y0, c_.x1, c_.y1, c_.wd, c_.cx0, c_.cy0, c_.cx1, c_.cy1 );
+	printf( "%d vs %d calls, first difference at %d", (int)a.size(), (int)b.size(), (int)i );
+	if ( i < a.size() )
+		printf( " (%d,%d) a=%d", a[i].x, a[i].y, a[i].alpha );
+	if ( i < b.size() )
+		printf( " vs (%d,%d) a=%d", b[i].x, b[i].y, b[i].alpha );
+	printf( "\n" );
+	return 1;
+}
+
+static int rnd( int lo_, int hi_ )
+{
+	return lo_ + rand() % ( hi_ - lo_ + 1 );
+}
+
+int main( int argc_, char *argv_[] )
+{
+	int n = argc_ > 1 ? atoi( argv_[1] ) : 5000;
+	static const struct { const char *name; Draw draw; } prims[] = {
+		{ "line", line }, { "line width", line_width },
+		{ "circle", circle }, { "ellipse", ellipse },
+		{ "filled circle", filled_circle }, { "filled ellipse", filled_ellipse }
+	};
+	// reported cases of the review of the ellipse clip
+	static const Case known[] = {
+		{ 360, 17, -41, 314, 1, 34, -34, 66, 101 },
+		{ 177, -187, 236, 399, 1, 65, -34, 202, 108 }
+	};
+	int fails = 0;
+	for ( size_t k = 0; k < sizeof( known ) / sizeof( known[0] ); k++ )
+		fails += check( "ellipse", ellipse, known[k] );
+	srand( 1 );
+	for ( size_t p = 0; p < sizeof( prims ) / sizeof( prims[0] ); p++ )
+	{
+		int f = 0;
+		for ( int i = 0; i < n; i++ )
+		{
+			Case c;
+			c.x0 = rnd( -200, 400 ); c.y0 = rnd( -200, 400 );
+			c.x1 = rnd( -200, 400 ); c.y1 = rnd( -200, 400 );
+			c.wd = rnd( 1, 40 ) / 4.f;
+			c.cx0 = rnd( -50, 250 ); c.cy0 = rnd( -50, 250 );
+			c.cx1 = c.cx0 + rnd( 0, 200 ); c.cy1 = c.cy0 + rnd( 0, 200 );
+			f += check( prims[p].name, prims[p].draw, c );
+		}
+		printf( "%-14s %d/%d cases differ\n", prims[p].name, f, n );
+		fails += f;
+	}
+	fails += check_baseline();
+	if ( fails )
+		return 1;
+	printf( "all tests passed\n" );
+	return 0;
+}
+#endif
@@ -0,0 +1,174 @@
+#ifndef FLTK_AA_COMPOSITE_H
+#define FLTK_AA_COMPOSITE_H
+
+/*
+	Compositing kernels for premultiplied RGBA buffers (as built by
+	aa_line.h in FL_AA_OVER mode) onto an RGB(x) backing store in place:
+
+		dst = src + dst * ( 255 - src_alpha ) / 255
+
+	The SSE2 and AVX2 variants handle 4 byte destination pixels, a
+	3 byte destination always uses the scalar kernel. The best kernel
+	supported by the cpu is selected at runtime (gcc/clang on x86).
+*/
+
+#include <algorithm>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define FL_AA_COMPOSITE_X86
+#include <immintrin.h>
+#endif
+
+enum
+{
+	FL_AA_KERNEL_AUTO = 0,
+	FL_AA_KERNEL_SCALAR = 1,
+	FL_AA_KERNEL_SSE2 = 2,
+	FL_AA_KERNEL_AVX2 = 3
+};
+
+typedef void ( *AA_Composite_Row )( const unsigned char *src_, unsigned char *dst_, int n_ );
+
+static inline unsigned char aa_over( unsigned s_, unsigned d_, unsigned ia_ )
+{
+	unsigned v = d_ * ia_ + 128;
+	return std::min( 255u, s_ + ( ( v + ( v >> 8 ) ) >> 8 ) );
+}
+
+static void aa_composite_row_scalar4( const unsigned char *src_, unsigned char *dst_, int n_ )
+{
+	for ( ; n_-- > 0; src_ += 4, dst_ += 4 )
+	{
+		unsigned ia = 255 - src_[3];
+		if ( ia == 255 )
+			continue;
+		dst_[0] = aa_over( src_[0], dst_[0], ia );
+		dst_[1] = aa_over( src_[1], dst_[1], ia );
+		dst_[2] = aa_over( src_[2], dst_[2], ia );
+		dst_[3] = aa_over( src_[3], dst_[3], ia );
+	}
+}
+
+static void aa_composite_row_scalar3( const unsigned char *src_, unsigned char *dst_, int n_ )
+{
+	for ( ; n_-- > 0; src_ += 4, dst_ += 3 )
+	{
+		unsigned ia = 255 - src_[3];
+		if ( ia == 255 )
+			continue;
+		dst_[0] = aa_over( src_[0], dst_[0], ia );
+		dst_[1] = aa_over( src_[1], dst_[1], ia );
+		dst_[2] = aa_over( src_[2], dst_[2], ia );
+	}
+}
+
+#ifdef FL_AA_COMPOSITE_X86
+
+__attribute__((target("sse2")))
+static inline __m128i aa_over_sse2( __m128i s_, __m128i d_ )
+{
+	// 2 pixels as 16 bit values: d * ( 255 - a ) / 255
+	const __m128i c255 = _mm_set1_epi16( 255 );
+	const __m128i c128 = _mm_set1_epi16( 128 );
+	__m128i a = _mm_shufflelo_epi16( s_, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	a = _mm_shufflehi_epi16( a, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	__m128i v = _mm_add_epi16( _mm_mullo_epi16( d_, _mm_sub_epi16( c255, a ) ), c128 );
+	return _mm_srli_epi16( _mm_add_epi16( v, _mm_srli_epi16( v, 8 ) ), 8 );
+}
+
+__attribute__((target("sse2")))
+static void aa_composite_row_sse2( const unsigned char *src_, unsigned char *dst_, int n_ )
+{
+	const __m128i zero = _mm_setzero_si128();
+	for ( ; n_ >= 4; n_ -= 4, src_ += 16, dst_ += 16 )
+	{
+		__m128i s = _mm_loadu_si128( (const __m128i *)src_ );
+		__m128i d = _mm_loadu_si128( (const __m128i *)dst_ );
+		__m128i lo = aa_over_sse2( _mm_unpacklo_epi8( s, zero ), _mm_unpacklo_epi8( d, zero ) );
+		__m128i hi = aa_over_sse2( _mm_unpackhi_epi8( s, zero ), _mm_unpackhi_epi8( d, zero ) );
+		d = _mm_adds_epu8( s, _mm_packus_epi16( lo, hi ) );
+		_mm_storeu_si128( (__m128i *)dst_, d );
+	}
+	aa_composite_row_scalar4( src_, dst_, n_ );
+}
+
+__attribute__((target("avx2")))
+static inline __m256i aa_over_avx2( __m256i s_, __m256i d_ )
+{
+	// 4 pixels as 16 bit values: d * ( 255 - a ) / 255
+	const __m256i c255 = _mm256_set1_epi16( 255 );
+	const __m256i c128 = _mm256_set1_epi16( 128 );
+	__m256i a = _mm256_shufflelo_epi16( s_, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	a = _mm256_shufflehi_epi16( a, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+	__m256i v = _mm256_add_epi16( _mm256_mullo_epi16( d_, _mm256_sub_epi16( c255, a ) ), c128 );
+	return _mm256_srli_epi16( _mm256_add_epi16( v, _mm256_srli_epi16( v, 8 ) ), 8 );
+}
+
+__attribute__((target("avx2")))
+static void aa_composite_row_avx2( const unsigned char *src_, unsigned char *dst_, int n_ )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	for ( ; n_ >= 8; n_ -= 8, src_ += 32, dst_ += 32 )
+	{
+		__m256i s = _mm256_loadu_si256( (const __m256i *)src_ );
+		__m256i d = _mm256_loadu_si256( (const __m256i *)dst_ );
+		// (unpack/pack work per 128 bit lane, so the pixel order is kept)
+		__m256i lo = aa_over_avx2( _mm256_unpacklo_epi8( s, zero ), _mm256_unpacklo_epi8( d, zero ) );
+		__m256i hi = aa_over_avx2( _mm256_unpackhi_epi8( s, zero ), _mm256_unpackhi_epi8( d, zero ) );
+		d = _mm256_adds_epu8( s, _mm256_packus_epi16( lo, hi ) );
+		_mm256_storeu_si256( (__m256i *)dst_, d );
+	}
+	aa_composite_row_scalar4( src_, dst_, n_ );
+}
+
+#endif // FL_AA_COMPOSITE_X86
+
+static int AA_Kernel = FL_AA_KERNEL_AUTO;
+
+static void fl_aa_composite_kernel( int kernel_ )
+{
+	// force a kernel (for testing), FL_AA_KERNEL_AUTO selects the best one
+	AA_Kernel = kernel_;
+}
+
+static int fl_aa_composite_kernel()
+{
+	// the kernel used for 4 byte destinations
+	static int best = 0;
+	if ( !best )
+	{
+		best = FL_AA_KERNEL_SCALAR;
+#ifdef FL_AA_COMPOSITE_X86
+		__builtin_cpu_init();
+		if ( __builtin_cpu_supports( "sse2" ) )
+			best = FL_AA_KERNEL_SSE2;
+		if ( __builtin_cpu_supports( "avx2" ) )
+			best = FL_AA_KERNEL_AVX2;
+#endif
+	}
+	return AA_Kernel == FL_AA_KERNEL_AUTO ? best : std::min( AA_Kernel, best );
+}
+
+static void fl_aa_composite( const unsigned char *src_, int src_ld_,
+                             unsigned char *dst_, int dst_d_, int dst_ld_,
+                             int w_, int h_ )
+{
+	// composite w_ x h_ premultiplied RGBA pixels onto RGB (dst_d_ = 3)
+	// or RGBx (dst_d_ = 4) pixels, line sizes in bytes
+	AA_Composite_Row row = aa_composite_row_scalar3;
+	if ( dst_d_ == 4 )
+	{
+		row = aa_composite_row_scalar4;
+#ifdef FL_AA_COMPOSITE_X86
+		switch ( fl_aa_composite_kernel() )
+		{
+			case FL_AA_KERNEL_SSE2: row = aa_composite_row_sse2; break;
+			case FL_AA_KERNEL_AVX2: row = aa_composite_row_avx2; break;
+		}
+#endif
+	}
+	for ( ; h_-- > 0; src_ += src_ld_, dst_ += dst_ld_ )
+		row( src_, dst_, w_ );
+}
+
+#endif
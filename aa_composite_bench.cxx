@@ -0,0 +1,97 @@
+/*
+	Benchmark compositing of the aa_line.h buffer at several window sizes:
+
+	- fl_end_aa() path: the dirty areas are drawn as Fl_RGB_Image with alpha
+	- kernel path: the buffer is composited onto a RGBx backing store with
+	  the scalar/SSE2/AVX2 kernels of aa_composite.h, which is then drawn
+	  with fl_draw_image()
+
+	Both paths draw into an Fl_Image_Surface of the tested size.
+	The result table is printed to stdout.
+*/
+#include "aa_line.h"
+
+#include <FL/Fl.H>
+#include <FL/Fl_Image_Surface.H>
+#include <FL/fl_draw.H>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static const int Runs = 20;
+
+static void scene( Fl_AA_Canvas &c_ )
+{
+	// some lines and circles covering most of the canvas
+	int w = c_.w();
+	int h = c_.h();
+	c_.color( FL_RED );
+	for ( int x = 0; x < w; x += 16 )
+		c_.line( x, 0, w - x, h - 1 );
+	c_.color( FL_BLUE );
+	for ( int r = 4; r < h / 2; r += 8 )
+		c_.circle( w / 2, h / 2, r );
+	c_.color( FL_GREEN );
+	c_.pie( w / 4, h / 4, h / 5 );
+}
+
+static double now()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+int main()
+{
+	static const int sizes[][2] = { { 320, 240 }, { 800, 600 }, { 1280, 720 }, { 1920, 1080 } };
+	static const char *kernels[] = { "", "scalar", "sse2", "avx2" };
+
+	printf( "%-10s %-16s %10s\n", "size", "path", "ms/frame" );
+	for ( size_t i = 0; i < sizeof( sizes ) / sizeof( sizes[0] ); i++ )
+	{
+		int w = sizes[i][0];
+		int h = sizes[i][1];
+		char size[20];
+		snprintf( size, sizeof( size ), "%dx%d", w, h );
+
+		Fl_AA_Canvas canvas( w, h );
+		canvas.blend( FL_AA_OVER );
+		scene( canvas );
+
+		Fl_Image_Surface surf( w, h );
+		Fl_Surface_Device::push_current( &surf );
+
+		// fl_end_aa() path
+		double start = now();
+		for ( int r = 0; r < Runs; r++ )
+			canvas.draw();
+		printf( "%-10s %-16s %10.3f\n", size, "fl_end_aa", ( now() - start ) * 1000 / Runs );
+
+		// kernel path
+		std::vector<uchar> store( w * h * 4 );
+		for ( int k = FL_AA_KERNEL_SCALAR; k <= FL_AA_KERNEL_AVX2; k++ )
+		{
+			fl_aa_composite_kernel( k );
+			if ( fl_aa_composite_kernel() != k )
+				continue;	// not supported by cpu
+			double t = 0;
+			start = now();
+			for ( int r = 0; r < Runs; r++ )
+			{
+				memset( &store[0], 255, store.size() );
+				double t0 = now();
+				canvas.composite( &store[0], 4 );
+				t += now() - t0;
+				fl_draw_image( &store[0], 0, 0, w, h, 4 );
+			}
+			char path[30];
+			snprintf( path, sizeof( path ), "%s", kernels[k] );
+			printf( "%-10s %-16s %10.3f\n", size, path, t * 1000 / Runs );
+			snprintf( path, sizeof( path ), "%s+draw", kernels[k] );
+			printf( "%-10s %-16s %10.3f\n", size, path, ( now() - start ) * 1000 / Runs );
+		}
+		fl_aa_composite_kernel( FL_AA_KERNEL_AUTO );
+
+		Fl_Surface_Device::pop_current();
+	}
+	return 0;
+}
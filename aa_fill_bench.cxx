@@ -0,0 +1,214 @@
+/*
+	Benchmark filling large AA pies (fl_pie_aa()) into the aa_line.h buffer:
+
+	- new: Fl_AA_Canvas::pie(), which fills the interior with whole
+	  rows (setHLine() -> 32 bit fills)
+	- old: the plotFilledCircleAA()/plotFilledEllipseRectAA() of the
+	  original contrib/bresenham_ext.c (below), which draw the outline
+	  and then fill every row with plotLine() -> setPixel()
+
+	Only the buffer is drawn to, no window is needed.
+	The result table is printed to stdout.
+*/
+#include "aa_line.h"
+
+#include <chrono>
+#include <cstdio>
+
+static const int Runs = 20;
+
+static double now()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+// the filled shapes of the original contrib/bresenham_ext.c (unchanged,
+// but renamed and with parentheses around the x step assignment)
+static void oldFilledCircle(int xm, int ym, int r)
+{
+   int x = -r, y = 0, err = 2-2*r;                /* bottom left to top right */
+   do {
+      plotLine(xm-x, ym+y, xm+x, ym+y);                /*   I. Quadrant +x +y */
+      plotLine(xm+x, ym-y, xm-x, ym-y);                /* III. Quadrant -x -y */
+      r = err;
+      if (r <= y) err += ++y*2+1;                             /* e_xy+e_y < 0 */
+      if (r > x || err > y)                  /* e_xy+e_x > 0 or no 2nd y-step */
+         err += ++x*2+1;                                     /* -> x-step now */
+   } while (x < 0);
+}
+
+static void oldFilledCircleAA(int xm, int ym, int r)
+{                     /* draw a black anti-aliased circle on white background */
+   int XM = xm;
+   int YM = ym;
+   int R = r;
+   int x = -r, y = 0;           /* II. quadrant from bottom left to top right */
+   int i, x2, e2, err = 2-2*r;                             /* error of 1.step */
+   r = 1-err;
+   do {
+      i = 255*abs(err-2*(x+y)-2)/r;               /* get blend value of pixel */
+      setPixelAA(xm-x, ym+y, i);                             /*   I. Quadrant */
+      setPixelAA(xm-y, ym-x, i);                             /*  II. Quadrant */
+      setPixelAA(xm+x, ym-y, i);                             /* III. Quadrant */
+      setPixelAA(xm+y, ym+x, i);                             /*  IV. Quadrant */
+      e2 = err; x2 = x;                                    /* remember values */
+      if (err+y > 0) {                                              /* x step */
+         i = 255*(err-2*x-1)/r;                              /* outward pixel */
+         if (i < 256) {
+            setPixelAA(xm-x, ym+y+1, i);
+            setPixelAA(xm-y-1, ym-x, i);
+            setPixelAA(xm+x, ym-y-1, i);
+            setPixelAA(xm+y+1, ym+x, i);
+         }
+         err += ++x*2+1;
+      }
+      if (e2+x2 <= 0) {                                             /* y step */
+         i = 255*(2*y+3-e2)/r;                                /* inward pixel */
+         if (i < 256) {
+            setPixelAA(xm-x2-1, ym+y, i);
+            setPixelAA(xm-y, ym-x2-1, i);
+            setPixelAA(xm+x2+1, ym-y, i);
+            setPixelAA(xm+y, ym+x2+1, i);
+         }
+         err += ++y*2+1;
+      }
+   } while (x < 0);
+   oldFilledCircle(XM, YM, R);
+}
+
+static void oldFilledEllipseRect(int x0, int y0, int x1, int y1)
+{                              /* rectangular parameter enclosing the ellipse */
+   long a = abs(x1-x0), b = abs(y1-y0), b1 = b&1;                 /* diameter */
+   double dx = 4*(1.0-a)*b*b, dy = 4*(b1+1)*a*a;           /* error increment */
+   double err = dx+dy+b1*a*a;                              /* error of 1.step */
+
+   if (x0 > x1) { x0 = x1; x1 += a; }        /* if called with swapped points */
+   if (y0 > y1) y0 = y1;                                  /* .. exchange them */
+   y0 += (b+1)/2; y1 = y0-b1;                               /* starting pixel */
+   a = 8*a*a; b1 = 8*b*b;
+
+   do {
+      plotLine(x1, y0, x0, y0);                              /*   I. Quadrant */
+      plotLine(x1, y1, x0, y1);                              /*  IV. Quadrant */
+      int e2 = 2*err;
+      if (e2 <= dy) { y0++; y1--; err += dy += a; }                 /* y step */
+      if (e2 >= dx || 2*err > dy) { x0++; x1--; err += dx += b1; }  /* x step */
+   } while (x0 <= x1);
+
+   while (y0-y1 <= b) {                /* too early stop of flat ellipses a=1 */
+      setPixel(x0-1, y0);                         /* -> finish tip of ellipse */
+      setPixel(x1+1, y0++);
+      setPixel(x0-1, y1);
+      setPixel(x1+1, y1--);
+   }
+}
+
+static void oldFilledEllipseRectAA(int x0, int y0, int x1, int y1)
+{        /* draw a black anti-aliased rectangular ellipse on white background */
+	int X0 = x0;
+	int Y0 = y0;
+	int X1 = x1;
+	int Y1 = y1;
+   long a = abs(x1-x0), b = abs(y1-y0), b1 = b&1;                 /* diameter */
+   float dx = 4*(a-1.0)*b*b, dy = 4*(b1+1)*a*a;            /* error increment */
+   float ed, i, err = b1*a*a-dx+dy;                        /* error of 1.step */
+	bool f;
+
+   if (a == 0 || b == 0) return plotLine(x0,y0, x1,y1);
+   if (x0 > x1) { x0 = x1; x1 += a; }        /* if called with swapped points */
+   if (y0 > y1) y0 = y1;                                  /* .. exchange them */
+   y0 += (b+1)/2; y1 = y0-b1;                               /* starting pixel */
+   a = 8*a*a; b1 = 8*b*b;
+
+   for (;;) {                             /* approximate ed=sqrt(dx*dx+dy*dy) */
+      i = std::min(dx,dy); ed = std::max(dx,dy);
+      if (y0 == y1+1 && err > dy && a > b1) ed = 255*4./a;           /* x-tip */
+      else ed = 255/(ed+2*ed*i*i/(4*ed*ed+i*i));             /* approximation */
+      i = ed*fabs(err+dx-dy);           /* get intensity value by pixel error */
+      setPixelAA(x0,y0, i); setPixelAA(x0,y1, i);
+      setPixelAA(x1,y0, i); setPixelAA(x1,y1, i);
+
+      if ((f = 2*err+dy >= 0)) {                /* x step, remember condition */
+         if (x0 >= x1) break;
+         i = ed*(err+dx);
+         if (i < 255) {
+            setPixelAA(x0,y0+1, i); setPixelAA(x0,y1-1, i);
+            setPixelAA(x1,y0+1, i); setPixelAA(x1,y1-1, i);
+         }          /* do error increment later since values are still needed */
+      }
+      if (2*err <= dx) {                                            /* y step */
+         i = ed*(dy-err);
+         if (i < 255) {
+            setPixelAA(x0+1,y0, i); setPixelAA(x1-1,y0, i);
+            setPixelAA(x0+1,y1, i); setPixelAA(x1-1,y1, i);
+         }
+         y0++; y1--; err += dy += a;
+      }
+      if (f) { x0++; x1--; err -= dx -= b1; }            /* x error increment */
+   }
+   if (--x0 == x1++)                       /* too early stop of flat ellipses */
+      while (y0-y1 < b) {
+         i = 255*4*fabs(err+dx)/b1;               /* -> finish tip of ellipse */
+         setPixelAA(x0,++y0, i); setPixelAA(x1,y0, i);
+         setPixelAA(x0,--y1, i); setPixelAA(x1,y1, i);
+         err += dy += a;
+      }
+   oldFilledEllipseRect(X0, Y0, X1, Y1);
+}
+
+static void old_pie( Fl_AA_Canvas &c_, int x_, int y_, int w_, int h_ )
+{
+	// a pie (w_ == h_: circle) drawn with the original functions into c_
+	Fl_AA_Canvas *prev = Fl_AA_Canvas::current();
+	Fl_AA_Canvas::current() = &c_;
+	if ( w_ == h_ )
+		oldFilledCircleAA( x_ + w_ / 2, y_ + h_ / 2, w_ / 2 );
+	else
+		oldFilledEllipseRectAA( x_, y_, x_ + w_ - 1, y_ + h_ - 1 );
+	c_.flush();
+	Fl_AA_Canvas::current() = prev;
+}
+
+int main()
+{
+	static const int radii[] = { 50, 200, 500 };
+	static const char *blends[] = { "replace", "over" };
+
+	printf( "%-8s %-8s %-8s %-8s %10s\n", "radius", "shape", "blend", "path", "ms/pie" );
+	for ( size_t i = 0; i < sizeof( radii ) / sizeof( radii[0] ); i++ )
+	{
+		int r = radii[i];
+		Fl_AA_Canvas canvas( 2 * r + 2, 2 * r + 2 );
+		canvas.color( 0, 128, 255 );
+		for ( int sh = 0; sh < 2; sh++ )
+		{
+			// circle of radius r or ellipse of 2r x r
+			int w = 2 * r + 1;
+			int h = sh ? r + 1 : w;
+			int y = sh ? r / 2 : 0;
+			for ( int bl = FL_AA_REPLACE; bl <= FL_AA_OVER; bl++ )
+			{
+				canvas.blend( bl );
+
+				double start = now();
+				for ( int run = 0; run < Runs; run++ )
+				{
+					if ( sh )
+						canvas.pie( 0, y, w, h );
+					else
+						canvas.pie( r, r, r );
+				}
+				printf( "%-8d %-8s %-8s %-8s %10.3f\n", r, sh ? "ellipse" : "circle", blends[bl], "new",
+				        ( now() - start ) * 1000 / Runs );
+
+				start = now();
+				for ( int run = 0; run < Runs; run++ )
+					old_pie( canvas, 0, y, w, h );
+				printf( "%-8d %-8s %-8s %-8s %10.3f\n", r, sh ? "ellipse" : "circle", blends[bl], "old",
+				        ( now() - start ) * 1000 / Runs );
+				canvas.clear();
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,299 @@
+/*
+	Golden image test of the antialiased rasterizers (contrib/bresenham*.c
+	and aa_line.h), no display needed:
+
+	Fixed scenes (lines at all octants and widths, circles, ellipses,
+	fills, curves, clipping, gamma table) are rendered into memory buffers and compared
+	pixel by pixel with the reference images in golden/:
+
+	- bresenham.pgm: coverage of the plain bresenham functions
+	- *.ppm: Fl_AA_Canvas scenes composited (FL_AA_OVER) onto white,
+	  each rendered immediately, in batch mode and with a shape cache,
+	  which must all give the reference image
+
+	Usage: aa_golden_test [--update] [tolerance]
+	A pixel fails if a channel differs by more than tolerance (default 0,
+	bit for bit). Failing images are written as golden/<name>.fail.p?m.
+	--update rewrites the reference images (after intended changes).
+	(make test runs it with tolerance 0)
+*/
+#include "aa_line.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const int W = 240;
+static const int H = 240;
+
+static void lines( Fl_AA_Canvas &c_ )
+{
+	// lines through all octants with several widths, subpixel lines
+	static const float widths[] = { 1, 2.5, 6 };
+	for ( int i = 0; i < 24; i++ )
+	{
+		double a = ( i * 15 + 3 ) * acos( -1. ) / 180;
+		int r = 40 + i % 3 * 25;
+		c_.color( i * 10, 255 - i * 10, i % 2 * 255 );
+		c_.line( 120, 120, 120 + (int)floor( r * cos( a ) + .5 ), 120 + (int)floor( r * sin( a ) + .5 ), widths[i % 3] );
+	}
+	c_.color( 0, 0, 0 );
+	c_.line( 5, 5, 234, 5 );
+	c_.line( 5, 5, 5, 234 );
+	c_.line( 5, 234, 234, 5, 1.5 );
+	for ( int i = 0; i < 8; i++ )
+	{
+		c_.color( 200, 0, i * 30 );
+		c_.line_f( 10 + i * .3f, 200 + i * 3.4f, 100 + i * .7f, 160 + i * 2.1f, i % 2 ? 1.f : 3.3f );
+	}
+}
+
+static void circles( Fl_AA_Canvas &c_ )
+{
+	// circles and ellipses, thin and stroked, subpixel circles, rotated
+	c_.color( 255, 0, 0 );
+	for ( int r = 1; r < 60; r += 4 )
+		c_.circle( 70, 70, r );
+	c_.color( 0, 0, 255 );
+	c_.circle( 170, 70, 50, 3 );
+	c_.circle( 170, 70, 30, 7.5 );
+	c_.ellipse( 10, 140, 100, 60 );
+	c_.ellipse( 20, 150, 80, 40, 4 );
+	c_.ellipse( 10, 210, 100, 20, 2 );
+	c_.color( 0, 160, 0 );
+	for ( int i = 0; i < 6; i++ )
+		c_.circle_f( 130 + i * 17.3f, 130.4f + i * .3f, 3 + i * 1.7f, i % 2 ? 1.f : 2.5f );
+	c_.color( 128, 0, 128 );
+	c_.rotated_ellipse( 175, 190, 50, 20, 30 );
+	c_.rotated_ellipse( 175, 190, 35, 12, 120, 5 );
+}
+
+static void fills( Fl_AA_Canvas &c_ )
+{
+	// pies and filled ellipses, overlapping with different colors
+	c_.color( 255, 0, 0 );
+	c_.pie( 60, 60, 50 );
+	c_.color( 0, 0, 255 );
+	c_.pie( 100, 80, 30 );
+	c_.color( 0, 160, 0 );
+	c_.pie( 130, 10, 100, 60 );
+	c_.pie( 140, 90, 30, 90 );
+	c_.color( 255, 160, 0 );
+	for ( int i = 0; i < 10; i++ )
+		c_.pie( 20 + i * 21, 200, i );
+	c_.color( 0, 0, 0 );
+	c_.pie( 10, 130, 111, 41 );
+	c_.color( 128, 128, 128 );
+	c_.pie( 180, 160, 40 );
+}
+
+static void curves( Fl_AA_Canvas &c_ )
+{
+	// bezier curves, splines and polylines, thin and stroked
+	c_.color( 255, 0, 0 );
+	c_.bezier( 10, 10, 120, 100, 230, 10 );
+	c_.bezier( 10, 40, 120, 130, 230, 40, .5f );
+	c_.bezier( 10, 70, 120, 160, 230, 70, 2.f, 4.f );
+	c_.color( 0, 0, 255 );
+	c_.bezier( 10, 100, 60, 10, 180, 200, 230, 100 );
+	c_.bezier( 10, 130, 60, 40, 180, 230, 230, 130, 3.f );
+	static const int spline[] = { 10, 200, 50, 160, 90, 220, 130, 170, 170, 230, 230, 180 };
+	c_.color( 0, 160, 0 );
+	c_.spline( spline, 6, 2 );
+	c_.color( 128, 0, 128 );
+	c_.spline( spline, 6, 3 );
+	int poly[2 * 40];
+	for ( int i = 0; i < 40; i++ )
+	{
+		poly[2 * i] = 10 + i * 55 / 10;
+		poly[2 * i + 1] = 150 + (int)floor( 20 * sin( i * .4 ) + .5 );
+	}
+	c_.color( 0, 0, 0 );
+	c_.polyline( poly, 40 );
+	for ( int i = 0; i < 40; i++ )
+		poly[2 * i + 1] += 60;
+	c_.polyline( poly, 40, 5 );
+}
+
+static void clipped( Fl_AA_Canvas &c_ )
+{
+	// all of the above through a clip rectangle
+	c_.clip( 30, 50, 170, 120 );
+	lines( c_ );
+	circles( c_ );
+	fills( c_ );
+	curves( c_ );
+}
+
+static void gamma( Fl_AA_Canvas &c_ )
+{
+	// lines and circles with coverage mapped by a gamma table
+	c_.gamma( 2.2f );
+	lines( c_ );
+	c_.clip( 0, 0, W / 2, H / 2 );
+	circles( c_ );
+}
+
+static void bresenham()
+{
+	// the plain bresenham functions (unclipped, drawn to the current canvas)
+	plotLineAA( 10, 10, 230, 60 );
+	plotLineAA( 10, 10, 60, 230 );
+	plotLineAA( 230, 10, 10, 30 );
+	plotLineWidth( 20, 230, 220, 100, 4 );
+	plotCircleAA( 120, 120, 50 );
+	plotEllipseRectAA( 20, 80, 220, 160 );
+	plotFilledCircleAA( 60, 180, 25 );
+	plotFilledEllipseRectAA( 140, 160, 230, 230 );
+	plotQuadBezierAA( 10, 230, 120, 100, 230, 230 );
+	plotCubicBezierAA( 10, 120, 80, 10, 160, 230, 230, 120 );
+	plotRotatedEllipseAA( 120, 120, 80, 30, 1 );
+}
+
+typedef void ( *Scene )( Fl_AA_Canvas &c_ );
+
+static bool read_image( const std::string &file_, const char *magic_, std::vector<uchar> &data_ )
+{
+	FILE *f = fopen( file_.c_str(), "rb" );
+	if ( !f )
+		return false;
+	char m[3] = "";
+	int w = 0, h = 0, max = 0;
+	bool ok = fscanf( f, "%2s %d %d %d", m, &w, &h, &max ) == 4 && !strcmp( m, magic_ ) &&
+	          w == W && h == H && max == 255 && fgetc( f ) != EOF &&
+	          fread( &data_[0], 1, data_.size(), f ) == data_.size();
+	fclose( f );
+	return ok;
+}
+
+static bool write_image( const std::string &file_, const char *magic_, const std::vector<uchar> &data_ )
+{
+	FILE *f = fopen( file_.c_str(), "wb" );
+	if ( !f )
+		return false;
+	fprintf( f, "%s\n%d %d\n255\n", magic_, W, H );
+	bool ok = fwrite( &data_[0], 1, data_.size(), f ) == data_.size();
+	return fclose( f ) == 0 && ok;
+}
+
+static bool check( const std::string &name_, const char *mode_, const std::vector<uchar> &data_,
+                   bool update_, int tolerance_ )
+{
+	// compare an image with its reference (or replace the reference)
+	bool gray = data_.size() == (size_t)W * H;
+	const char *magic = gray ? "P5" : "P6";
+	std::string file = "golden/" + name_ + ( gray ? ".pgm" : ".ppm" );
+	if ( update_ )
+	{
+		if ( !write_image( file, magic, data_ ) )
+		{
+			printf( "FAIL %-14s %-10s can't write %s\n", name_.c_str(), mode_, file.c_str() );
+			return false;
+		}
+		printf( "updated %s\n", file.c_str() );
+		return true;
+	}
+	std::vector<uchar> ref( data_.size() );
+	if ( !read_image( file, magic, ref ) )
+	{
+		printf( "FAIL %-14s %-10s can't read %s\n", name_.c_str(), mode_, file.c_str() );
+		return false;
+	}
+	int d = gray ? 1 : 3;
+	int bad = 0, maxDiff = 0;
+	for ( size_t i = 0; i < data_.size(); i += d )
+	{
+		int diff = 0;
+		for ( int k = 0; k < d; k++ )
+			diff = std::max( diff, abs( data_[i + k] - ref[i + k] ) );
+		maxDiff = std::max( maxDiff, diff );
+		if ( diff > tolerance_ )
+			bad++;
+	}
+	printf( "%s %-14s %-10s %6d pixels off (max. diff %d)\n", bad ? "FAIL" : "ok  ",
+	        name_.c_str(), mode_, bad, maxDiff );
+	if ( bad )
+		write_image( "golden/" + name_ + ".fail" + ( gray ? ".pgm" : ".ppm" ), magic, data_ );
+	return !bad;
+}
+
+int main( int argc_, char *argv_[] )
+{
+	bool update = false;
+	int tolerance = 0;
+	for ( int i = 1; i < argc_; i++ )
+	{
+		if ( !strcmp( argv_[i], "--update" ) )
+			update = true;
+		else if ( isdigit( (uchar)argv_[i][0] ) )
+			tolerance = atoi( argv_[i] );
+		else
+		{
+			fprintf( stderr, "usage: %s [--update] [tolerance]\n", argv_[0] );
+			return 2;
+		}
+	}
+
+	bool ok = true;
+
+	// plain bresenham functions: coverage (alpha channel)
+	{
+		Fl_AA_Canvas canvas( W, H );
+		Fl_AA_Canvas::current() = &canvas;
+		bresenham();
+		Fl_AA_Canvas::current() = 0;
+		canvas.flush();
+		std::vector<uchar> gray( W * H );
+		for ( int i = 0; i < W * H; i++ )
+			gray[i] = canvas.buffer()[i * 4 + 3];
+		ok &= check( "bresenham", "plain", gray, update, tolerance );
+	}
+
+	// canvas scenes
+	static const struct { const char *name; Scene scene; } scenes[] =
+	{
+		{ "lines", lines },
+		{ "circles", circles },
+		{ "fills", fills },
+		{ "curves", curves },
+		{ "clipped", clipped },
+		{ "gamma", gamma },
+	};
+	static const char *modes[] = { "immediate", "batch", "cached" };
+	for ( size_t s = 0; s < sizeof( scenes ) / sizeof( scenes[0] ); s++ )
+		for ( int m = 0; m < ( update ? 1 : 3 ); m++ )
+		{
+			std::vector<uchar> rgba( W * H * 4, 255 );
+			AA_Shape_Cache cache;
+			Fl_AA_Canvas canvas;
+			canvas.blend( FL_AA_OVER );
+			canvas.attach( &rgba[0], W, H );
+			if ( m == 2 )
+			{
+				// (twice, so the second time is drawn from the cache)
+				canvas.shape_cache( &cache );
+				std::vector<uchar> tmp( W * H * 4 );
+				Fl_AA_Canvas warm;
+				warm.shape_cache( &cache );
+				warm.attach( &tmp[0], W, H );
+				scenes[s].scene( warm );
+			}
+			if ( m == 1 )
+				canvas.begin_batch();
+			scenes[s].scene( canvas );
+			if ( m == 1 )
+				canvas.end_batch( 2 );
+			canvas.flush();
+
+			std::vector<uchar> rgb( W * H * 3 );
+			for ( int i = 0; i < W * H; i++ )
+				memcpy( &rgb[i * 3], &rgba[i * 4], 3 );
+			ok &= check( scenes[s].name, modes[m], rgb, update, tolerance );
+		}
+
+	printf( ok ? "all tests passed\n" : "TESTS FAILED\n" );
+	return ok ? 0 : 1;
+}
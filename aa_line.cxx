@@ -75,6 +75,8 @@ public:
 
 int main()
 {
+	fl_aa_persistent( true ); // keep aa buffer between redraws
+	fl_aa_blend( FL_AA_OVER ); // accumulate overlapping primitives
 	MyWindow win( 600, 600, "antialiasing" );
 	win.resizable( win );
 	win.end();
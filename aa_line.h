@@ -4,11 +4,23 @@
 #include <cmath>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
+#include <climits>
+#include <stdint.h>
+#include <initializer_list>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
 
 // forward declaration of functions to be implemented by application
 static void setPixelAA( int x, int y, unsigned char alpha );
 static void setPixel( int x, int y );
+static void setHLine( int x0, int x1, int y );
 
 #include "contrib/bresenham.c"
 #include "contrib/bresenham_ext.c"
@@ -17,23 +29,1517 @@ static void setPixel( int x, int y );
 // FLTK interface
 #include <FL/fl_draw.H>
 #include <FL/Fl.H>
+#include <FL/Fl_RGB_Image.H>
 
-static uchar *OffScreenBuf = 0;
-static int W = 0;
-static int H = 0;
+#include "aa_composite.h"
 
 
-static void setPixelAA( int x, int y, unsigned char alpha )
+// compositing
+//    Every pixel is written into the buffer when it is plotted.
+//    Polylines (and thick curves, which are drawn as polylines) and
+//    primitives grouped by color collect their coverage in a mask of
+//    buffer size instead (pixels plotted twice get the max. coverage),
+//    which is composited row by row when the primitive is finished.
+//    Interiors of filled shapes are written as whole rows.
+
+// blend modes
+//    FL_AA_REPLACE sets color and alpha of a pixel, so the last primitive
+//    drawn to a pixel wins.
+//    FL_AA_OVER composites each primitive on top of the previous ones
+//    ("source over"), keeping premultiplied RGBA in the buffer.
+enum { FL_AA_REPLACE = 0, FL_AA_OVER = 1 };
+
+static inline unsigned aa_div255( unsigned v_ )
 {
-	// draw a pixel in current color at x/y with alpha value
-	if ( OffScreenBuf )
+	// v_ / 255 rounded, for v_ <= 255 * 255
+	v_ += 128;
+	return ( v_ + ( v_ >> 8 ) ) >> 8;
+}
+
+struct AA_Span
+{
+	int y, x0, x1;	// row and first/last pixel of span
+	int cov;	// alpha of a pixel, 256: opaque row
+};
+
+struct AA_Box
+{
+	int x0, y0, x1, y1;	// inclusive
+	long area() const { return (long)( x1 - x0 + 1 ) * ( y1 - y0 + 1 ); }
+	bool touches( const AA_Box &b_ ) const
+	{
+		return x0 <= b_.x1 + 1 && b_.x0 <= x1 + 1 &&
+		       y0 <= b_.y1 + 1 && b_.y0 <= y1 + 1;
+	}
+	void merge( const AA_Box &b_ )
+	{
+		x0 = std::min( x0, b_.x0 );
+		y0 = std::min( y0, b_.y0 );
+		x1 = std::max( x1, b_.x1 );
+		y1 = std::max( y1, b_.y1 );
+	}
+	bool operator==( const AA_Box &b_ ) const
+	{
+		return x0 == b_.x0 && y0 == b_.y0 && x1 == b_.x1 && y1 == b_.y1;
+	}
+};
+
+// recorded primitive (batch mode)
+enum
+{
+	AA_LINE, AA_CIRCLE, AA_ELLIPSE, AA_PIE, AA_PIE_ELLIPSE, AA_BEZIER,
+	AA_CUBIC_BEZIER, AA_RATIONAL_BEZIER, AA_ROTATED_ELLIPSE, AA_SPLINE,
+	AA_POLYLINE, AA_LINE_FIXED, AA_CIRCLE_FIXED
+};
+
+static inline int aa_fixed( float v_ )
+{
+	// float coordinate to 24.8 fixed point
+	return (int)floor( v_ * 256 + .5f );
+}
+
+struct AA_Command
+{
+	AA_Command( int type_ = 0, std::initializer_list<int> p_ = {}, float width_ = 0, float param_ = 0 ) :
+		type( type_ ),
+		p(),
+		width( width_ ),
+		param( param_ ),
+		r( 0 ), g( 0 ), b( 0 ),
+		clip(),
+		box()
+	{
+		// (unused coordinates are 0)
+		assert( p_.size() <= 8 );
+		std::copy( p_.begin(), p_.end(), p );
+	}
+	int type;
+	int p[8];	// coordinates (spline/polyline: offset and number of
+	        	// points, spline degree/offset of polyline chunk boxes,
+	        	// *_FIXED: 24.8 fixed point)
+	float width;	// line/stroke width
+	float param;	// rational bezier weight, rotation angle
+	uchar r, g, b;	// color
+	AA_Box clip;	// clip rectangle when recorded
+	AA_Box box;	// bounding box (clipped)
+	bool operator==( const AA_Command &c_ ) const
+	{
+		// same primitive (the box follows from the others)
+		return type == c_.type && std::equal( p, p + 8, c_.p ) &&
+		       width == c_.width && param == c_.param &&
+		       r == c_.r && g == c_.g && b == c_.b && clip == c_.clip;
+	}
+};
+
+// rasterized primitive (shape cache)
+struct AA_Shape
+{
+	// the plotted pixels (cov: alpha) and rows (cov: 256) in plotting
+	// order, relative to the primitive's position (p[0]/p[1] of its
+	// command)
+	std::vector<AA_Span> plots;
+	bool masked;	// plots collected in the mask (thick curves)
+	AA_Shape() : masked( false ) {}
+	size_t bytes() const
+	{
+		return sizeof( AA_Shape ) + plots.size() * sizeof( AA_Span );
+	}
+};
+
+// AA_Shape_Cache
+//    LRU cache of rasterized primitives that only differ in position:
+//    circles, ellipses and pies keyed by type, size, stroke width (and
+//    angle), which are then replayed from the cache at any position.
+//    The least recently used shapes are dropped when the cache holds
+//    more than capacity() bytes. Can be used by several canvases and
+//    their batch workers at once.
+class AA_Shape_Cache
+{
+public:
+	struct Key
+	{
+		int type;
+		int size[2];	// radius or width/height or radii
+		float width, param;
+		bool operator<( const Key &k_ ) const
+		{
+			if ( type != k_.type ) return type < k_.type;
+			if ( size[0] != k_.size[0] ) return size[0] < k_.size[0];
+			if ( size[1] != k_.size[1] ) return size[1] < k_.size[1];
+			if ( width != k_.width ) return width < k_.width;
+			return param < k_.param;
+		}
+	};
+	typedef std::shared_ptr<const AA_Shape> Shape;
+
+	AA_Shape_Cache( size_t capacity_ = 4 << 20 ) :
+		_capacity( capacity_ ),
+		_bytes( 0 ),
+		_hits( 0 ),
+		_misses( 0 )
+	{
+	}
+	static bool cacheable( const AA_Command &c_ )
+	{
+		// primitives whose pixels only depend on size when moved by
+		// whole pixels
+		return c_.type == AA_CIRCLE || c_.type == AA_ELLIPSE || c_.type == AA_PIE ||
+		       c_.type == AA_PIE_ELLIPSE || c_.type == AA_ROTATED_ELLIPSE;
+	}
+	static Key key( const AA_Command &c_ )
+	{
+		Key k = { c_.type, { c_.p[2], c_.p[3] }, c_.width, c_.param };
+		return k;
+	}
+	Shape find( const Key &k_ )
+	{
+		// cached shape or null (counted as hit or miss)
+		std::lock_guard<std::mutex> lock( _mutex );
+		std::map<Key, Lru::iterator>::iterator i = _index.find( k_ );
+		if ( i == _index.end() )
+		{
+			_misses++;
+			return Shape();
+		}
+		_hits++;
+		_lru.splice( _lru.begin(), _lru, i->second );
+		return i->second->second;
+	}
+	void insert( const Key &k_, const Shape &s_ )
+	{
+		// add a shape, dropping least recently used ones if needed
+		std::lock_guard<std::mutex> lock( _mutex );
+		if ( s_->bytes() > _capacity || _index.count( k_ ) )
+			return;
+		_lru.push_front( std::make_pair( k_, s_ ) );
+		_index[k_] = _lru.begin();
+		_bytes += s_->bytes();
+		trim();
+	}
+	void capacity( size_t capacity_ )
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_capacity = capacity_;
+		trim();
+	}
+	size_t capacity() const
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		return _capacity;
+	}
+	void clear()
+	{
+		// drop all shapes and reset the counters
+		std::lock_guard<std::mutex> lock( _mutex );
+		_lru.clear();
+		_index.clear();
+		_bytes = 0;
+		_hits = _misses = 0;
+	}
+	size_t bytes() const
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		return _bytes;
+	}
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		return _index.size();
+	}
+	unsigned long hits() const
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		return _hits;
+	}
+	unsigned long misses() const
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		return _misses;
+	}
+
+private:
+	typedef std::list<std::pair<Key, Shape> > Lru;
+	void trim()
+	{
+		while ( _bytes > _capacity )
+		{
+			_bytes -= _lru.back().second->bytes();
+			_index.erase( _lru.back().first );
+			_lru.pop_back();
+		}
+	}
+
+	mutable std::mutex _mutex;	// (the accessors are called while workers insert)
+	size_t _capacity;	// max. bytes
+	size_t _bytes;	// bytes of the cached shapes
+	unsigned long _hits, _misses;
+	Lru _lru;	// most recently used first
+	std::map<Key, Lru::iterator> _index;
+};
+
+
+// Fl_AA_Canvas
+//    Owns an RGBA buffer, a clip rectangle and a current color and
+//    rasterizes antialiased primitives into it.
+//    The rasterizing methods don't use any FLTK drawing functions, so
+//    different canvases can be drawn into concurrently from different
+//    threads. Only draw() (which composites the buffer onto the current
+//    FLTK surface) must be called from the UI thread.
+//    In batch mode the primitives are only recorded and rasterized by
+//    end_batch() with a pool of worker threads, each rasterizing all
+//    primitives touching a 64x64 tile clipped to that tile. Primitives
+//    are processed in recording order within every tile, so the result
+//    is the same as drawing them one after the other.
+//    A frame recorded with begin_frame()/end_frame() is rasterized the
+//    same way, but only if it differs from the previous frame, otherwise
+//    the buffer still holds the result.
+//    With a shape cache (shape_cache()) circles, ellipses and pies are
+//    replayed from their cached pixels, with the same result as
+//    rasterizing them.
+class Fl_AA_Canvas
+{
+public:
+	Fl_AA_Canvas( int w_ = 0, int h_ = 0 ) :
+		_buf( 0 ),
+		_w( 0 ),
+		_h( 0 ),
+		_r( 0 ), _g( 0 ), _b( 0 ),
+		_blend( FL_AA_REPLACE ),
+		_minY( 0 ),
+		_maxY( -1 ),
+		_dx0( INT_MAX ), _dy0( INT_MAX ),
+		_dx1( INT_MIN ), _dy1( INT_MIN ),
+		_shared( false ),
+		_batch( false ),
+		_frame( false ),
+		_group( false ),
+		_merge( false ),
+		_prevValid( false ),
+		_masked( false ),
+		_cache( 0 ),
+		_capture( false ),
+		_capShape( 0 )
+	{
+		clip( 0, 0, 0, 0 );
+		reset_dirty();
+		gamma( 1 );
+		if ( w_ > 0 && h_ > 0 )
+			size( w_, h_ );
+	}
+	~Fl_AA_Canvas()
+	{
+		release();
+	}
+	void size( int w_, int h_ )
+	{
+		// (re)allocate a cleared buffer, reset clip rectangle
+		release();
+		_buf = new uchar[w_ * h_ * 4];
+		_w = w_;
+		_h = h_;
+		clip( 0, 0, _w, _h );
+		clear();
+	}
+	void attach( uchar *buf_, int w_, int h_ )
+	{
+		// draw directly into an RGBA buffer of the caller (w_ * h_ * 4
+		// bytes, not cleared and not freed), with FL_AA_OVER primitives
+		// are composited onto its content (which should be premultiplied
+		// or opaque)
+		release();
+		_buf = buf_;
+		_w = w_;
+		_h = h_;
+		_shared = true;
+		clip( 0, 0, _w, _h );
+		reset_dirty();
+	}
+	void release()
+	{
+		// free buffer (or detach from caller's buffer)
+		_commands.clear();
+		_points.clear();
+		_boxes.clear();
+		std::vector<uchar>().swap( _mask );
+		_prevValid = false;
+		if ( !_shared )
+			delete[] _buf;
+		_shared = false;
+		_buf = 0;
+		_w = _h = 0;
+		clip( 0, 0, 0, 0 );
+	}
+	void clear()
+	{
+		_prevValid = false;
+		_minY = _h;
+		_maxY = -1;
+		reset_dirty();
+		if ( _buf )
+			memset( _buf, 0, _w * _h * 4 );
+	}
+	void begin( int w_, int h_ )
+	{
+		// start a new frame reusing the buffer of the previous frame:
+		// reallocate only if the size changed, otherwise clear only
+		// the area that was drawn to
+		if ( !_buf || w_ != _w || h_ != _h )
+		{
+			size( w_, h_ );
+			return;
+		}
+		clip( 0, 0, _w, _h );
+		clear_dirty();
+	}
+	void clear_dirty()
+	{
+		// clear only the areas drawn to since last clear
+		flush();
+		_prevValid = false;
+		for ( size_t i = 0; _buf && i < _dirty.size(); i++ )
+		{
+			const AA_Box &b = _dirty[i];
+			size_t n = ( b.x1 - b.x0 + 1 ) * 4;
+			for ( int y = b.y0; y <= b.y1; y++ )
+				memset( _buf + y * 4 * _w + b.x0 * 4, 0, n );
+		}
+		reset_dirty();
+	}
+	bool dirty( int &x_, int &y_, int &w_, int &h_ ) const
+	{
+		// bounding box of the pixels drawn since last clear
+		if ( _dirty.empty() )
+			return false;
+		AA_Box u = _dirty[0];
+		for ( size_t i = 1; i < _dirty.size(); i++ )
+			u.merge( _dirty[i] );
+		x_ = u.x0;
+		y_ = u.y0;
+		w_ = u.x1 - u.x0 + 1;
+		h_ = u.y1 - u.y0 + 1;
+		return true;
+	}
+	const std::vector<AA_Box> &dirty_boxes() const
+	{
+		// the (non overlapping) areas drawn to since last clear
+		return _dirty;
+	}
+	int w() const { return _w; }
+	int h() const { return _h; }
+	uchar *buffer() const { return _buf; }
+	void clip( int x_, int y_, int w_, int h_ )
+	{
+		// limit drawing to rectangle (intersected with buffer)
+		flush();
+		_cx0 = std::max( x_, 0 );
+		_cy0 = std::max( y_, 0 );
+		_cx1 = std::min( x_ + w_, _w ) - 1;
+		_cy1 = std::min( y_ + h_, _h ) - 1;
+	}
+	void color( uchar r_, uchar g_, uchar b_ )
+	{
+		flush();
+		_r = r_;
+		_g = g_;
+		_b = b_;
+	}
+	void color( Fl_Color c_ )
+	{
+		uchar r, g, b;
+		Fl::get_color( c_, r, g, b );
+		color( r, g, b );
+	}
+	void blend( int blend_ )
+	{
+		// change blend mode (the buffer should be empty)
+		flush();
+		_prevValid = false;
+		_blend = blend_;
+	}
+	int blend() const { return _blend; }
+	void gamma( float gamma_ )
+	{
+		// map the coverage of antialiased pixels to alpha by
+		// coverage ^ ( 1 / gamma_ ) with a lookup table: gamma_ > 1 makes
+		// thin lines heavier, < 1 lighter, 1 is linear (opaque pixels
+		// are not affected)
+		flush();
+		_prevValid = false;
+		_gamma = gamma_ > 0 ? gamma_ : 1;
+		for ( int i = 0; i < 256; i++ )
+			_lut[i] = (uchar)floor( 255 * pow( i / 255., 1 / _gamma ) + .5 );
+	}
+	float gamma() const { return _gamma; }
+	void shape_cache( AA_Shape_Cache *cache_ )
+	{
+		// composite circles, ellipses and pies from a cache of rasterized
+		// shapes instead of rasterizing each (0: no cache)
+		flush();
+		_prevValid = false;
+		_cache = cache_;
+	}
+	AA_Shape_Cache *shape_cache() const { return _cache; }
+
+	// primitives
+	void line( int x0_, int y0_, int x1_, int y1_, float width_ = 1. )
+	{
+		AA_Command c( AA_LINE, { x0_, y0_, x1_, y1_ }, width_ );
+		add( c );
+	}
+	void circle( int x_, int y_, int r_, float width_ = 1. )
+	{
+		AA_Command c( AA_CIRCLE, { x_, y_, r_ }, width_ );
+		add( c );
+	}
+	void line_f( float x0_, float y0_, float x1_, float y1_, float width_ = 1. )
+	{
+		// line with subpixel end points (pixel centers are at integers)
+		AA_Command c( AA_LINE_FIXED, { aa_fixed( x0_ ), aa_fixed( y0_ ), aa_fixed( x1_ ), aa_fixed( y1_ ) }, width_ );
+		add( c );
+	}
+	void circle_f( float x_, float y_, float r_, float width_ = 1. )
+	{
+		// circle with subpixel center and radius
+		AA_Command c( AA_CIRCLE_FIXED, { aa_fixed( x_ ), aa_fixed( y_ ), aa_fixed( std::max( r_, 0.f ) ) }, width_ );
+		add( c );
+	}
+	void ellipse( int x_, int y_, int w_, int h_, float width_ = 1. )
+	{
+		AA_Command c( AA_ELLIPSE, { x_, y_, w_, h_ }, width_ );
+		add( c );
+	}
+	void pie( int x_, int y_, int r_ )
+	{
+		AA_Command c( AA_PIE, { x_, y_, r_ } );
+		add( c );
+	}
+	void pie( int x_, int y_, int w_, int h_ )
+	{
+		AA_Command c( AA_PIE_ELLIPSE, { x_, y_, w_, h_ } );
+		add( c );
+	}
+	void bezier( int x0_, int y0_, int x1_, int y1_, int x2_, int y2_ )
+	{
+		// quadratic bezier curve (for a width use the rational
+		// version with weight 1)
+		AA_Command c( AA_BEZIER, { x0_, y0_, x1_, y1_, x2_, y2_ } );
+		add( c );
+	}
+	void bezier( int x0_, int y0_, int x1_, int y1_, int x2_, int y2_, float w_, float width_ = 1. )
+	{
+		// rational quadratic bezier curve, weight w_ >= 0 of the
+		// middle point (w_ < 1: ellipse, w_ = 1: parabola, w_ > 1: hyperbola)
+		AA_Command c( AA_RATIONAL_BEZIER, { x0_, y0_, x1_, y1_, x2_, y2_ }, width_, std::max( w_, 0.f ) );
+		add( c );
+	}
+	void bezier( int x0_, int y0_, int x1_, int y1_, int x2_, int y2_, int x3_, int y3_, float width_ = 1. )
+	{
+		// cubic bezier curve
+		AA_Command c( AA_CUBIC_BEZIER, { x0_, y0_, x1_, y1_, x2_, y2_, x3_, y3_ }, width_ );
+		add( c );
+	}
+	void rotated_ellipse( int x_, int y_, int a_, int b_, float angle_, float width_ = 1. )
+	{
+		// ellipse with center x_/y_ and radii a_/b_ rotated clockwise
+		// by angle_ degrees
+		AA_Command c( AA_ROTATED_ELLIPSE, { x_, y_, a_, b_ }, width_, angle_ );
+		add( c );
+	}
+	void spline( const int *xy_, int n_, int degree_ = 3 )
+	{
+		// quadratic (degree_ 2) or cubic spline through n_ points
+		// given as x/y pairs
+		if ( n_ < 1 )
+			return;
+		AA_Command c( AA_SPLINE, { (int)_points.size(), n_, degree_ } );
+		_points.insert( _points.end(), xy_, xy_ + 2 * n_ );
+		add( c );
+		if ( !_batch )
+			_points.clear();
+	}
+	void polyline( const int *xy_, int n_, float width_ = 1. )
+	{
+		// connected lines through n_ points given as x/y pairs, drawn as
+		// one primitive (joins are plotted once, round for width_ > 2)
+		if ( n_ < 1 )
+			return;
+		AA_Command c( AA_POLYLINE, { (int)_points.size(), n_, (int)_boxes.size() }, width_ );
+		_points.insert( _points.end(), xy_, xy_ + 2 * n_ );
+
+		// bounding boxes of chunks of segments, to skip invisible
+		// parts quickly (and to bin the chunks into tiles)
+		int d = (int)ceil( width_ / 2 ) + 1;
+		for ( int i = 0; i < n_; i += POLY_CHUNK )
+		{
+			AA_Box b = { xy_[2 * i], xy_[2 * i + 1], xy_[2 * i], xy_[2 * i + 1] };
+			for ( int j = i + 1; j <= i + POLY_CHUNK && j < n_; j++ )
+			{
+				b.x0 = std::min( b.x0, xy_[2 * j] );
+				b.y0 = std::min( b.y0, xy_[2 * j + 1] );
+				b.x1 = std::max( b.x1, xy_[2 * j] );
+				b.y1 = std::max( b.y1, xy_[2 * j + 1] );
+			}
+			b.x0 -= d;
+			b.y0 -= d;
+			b.x1 += d;
+			b.y1 += d;
+			_boxes.push_back( b );
+		}
+		add( c );
+		if ( !_batch )
+		{
+			_points.clear();
+			_boxes.clear();
+		}
+	}
+
+	// batch mode
+	void begin_batch()
+	{
+		// record primitives from now on
+		flush();
+		_commands.clear();
+		_points.clear();
+		_boxes.clear();
+		_batch = true;
+	}
+	bool batch() const { return _batch; }
+	void end_batch( int threads_ = 0 )
+	{
+		// rasterize recorded primitives with threads_ workers
+		// (0: one per cpu core)
+		_batch = false;
+		_prevValid = false;
+		rasterize( threads_ );
+		_commands.clear();
+		_points.clear();
+		_boxes.clear();
+	}
+	void begin_frame( int w_, int h_ )
+	{
+		// start recording a frame: like begin() and begin_batch(), but
+		// the buffer is cleared by end_frame() only if the frame differs
+		// from the previous one
+		if ( !_buf || w_ != _w || h_ != _h )
+			size( w_, h_ );
+		clip( 0, 0, _w, _h );
+		begin_batch();
+		_frame = true;
+	}
+	bool frame() const { return _frame; }
+	bool end_frame( int threads_ = 0 )
+	{
+		// rasterize the recorded frame like end_batch(), unless it has
+		// the same primitives as the previous frame (then the buffer and
+		// its dirty areas are left as they are), returns true if rasterized
+		_batch = false;
+		_frame = false;
+		bool same = _prevValid && _commands == _prevCommands &&
+		            _points == _prevPoints && _boxes == _prevBoxes;
+		if ( !same )
+		{
+			clear_dirty();
+			rasterize( threads_ );
+			_prevCommands.swap( _commands );
+			_prevPoints.swap( _points );
+			_prevBoxes.swap( _boxes );
+			_prevValid = true;
+		}
+		_commands.clear();
+		_points.clear();
+		_boxes.clear();
+		return !same;
+	}
+	void group_colors( bool group_ )
+	{
+		// let end_batch()/end_frame() reorder the primitives by color and
+		// composite the ones of the same color within a tile together
+		// (overlaps get the max. coverage instead of being blended), only
+		// for scenes where the order of different colors doesn't matter
+		_group = group_;
+		_prevValid = false;
+	}
+	bool group_colors() const { return _group; }
+
+	void draw( int x_ = 0, int y_ = 0 )
+	{
+		// composite buffer onto current FLTK surface (UI thread only),
+		// only the dirty areas are drawn as sub images of the buffer
+		flush();
+		if ( !_buf )
+			return;
+		for ( size_t i = 0; i < _dirty.size(); i++ )
+		{
+			const AA_Box &b = _dirty[i];
+			int w = b.x1 - b.x0 + 1;
+			int h = b.y1 - b.y0 + 1;
+			const uchar *data = _buf + b.y0 * 4 * _w + b.x0 * 4;
+			int ld = _w * 4;
+			if ( _blend == FL_AA_OVER )
+			{
+				// FLTK wants straight alpha
+				unpremultiply( data, ld, w, h );
+				data = &_scratch[0];
+				ld = w * 4;
+			}
+			Fl_RGB_Image rgb( data, w, h, 4, ld );
+			rgb.draw( x_ + b.x0, y_ + b.y0 );
+		}
+	}
+
+	void composite( uchar *dst_, int d_, int ld_ = 0 )
+	{
+		// composite the dirty areas onto a backing store of the caller
+		// with the same size as the canvas, that has RGB (d_ = 3) or
+		// RGBx (d_ = 4) pixels, using the fastest kernel of aa_composite.h
+		flush();
+		if ( !ld_ )
+			ld_ = _w * d_;
+		for ( size_t i = 0; _buf && i < _dirty.size(); i++ )
+		{
+			const AA_Box &b = _dirty[i];
+			int w = b.x1 - b.x0 + 1;
+			int h = b.y1 - b.y0 + 1;
+			const uchar *src = _buf + b.y0 * 4 * _w + b.x0 * 4;
+			int ld = _w * 4;
+			if ( _blend != FL_AA_OVER )
+			{
+				// kernels want premultiplied alpha
+				premultiply( src, ld, w, h );
+				src = &_scratch[0];
+				ld = w * 4;
+			}
+			fl_aa_composite( src, ld, dst_ + b.y0 * ld_ + b.x0 * d_, d_, ld_, w, h );
+		}
+	}
+
+	void pixel( int x_, int y_, uchar alpha_ )
+	{
+		// draw a pixel in current color with alpha value (0 = opaque)
+		if ( x_ < _cx0 || y_ < _cy0 || x_ > _cx1 || y_ > _cy1 )
+			return;
+		if ( _capture )
+		{
+			AA_Span s = { y_, x_, x_, alpha_ };
+			_capShape->plots.push_back( s );
+			return;
+		}
+		if ( _masked )
+		{
+			uchar &m = _mask[y_ * _w + x_];
+			m = std::max( m, (uchar)( 255 - alpha_ ) );
+			if ( x_ < _maskX0[y_] ) _maskX0[y_] = x_;
+			if ( x_ > _maskX1[y_] ) _maskX1[y_] = x_;
+			if ( y_ < _minY ) _minY = y_;
+			if ( y_ > _maxY ) _maxY = y_;
+			return;
+		}
+		add_dirty( x_, x_, y_ );
+		uchar coverage = 255 - alpha_;
+		blend_span( _buf + y_ * 4 * _w + x_ * 4, &coverage, 1 );
+	}
+	void hline( int x0_, int x1_, int y_ )
+	{
+		// draw pixels x0_..x1_ of row y_ opaque in current color
+		if ( y_ < _cy0 || y_ > _cy1 )
+			return;
+		x0_ = std::max( x0_, _cx0 );
+		x1_ = std::min( x1_, _cx1 );
+		if ( x0_ > x1_ )
+			return;
+		if ( _capture )
+		{
+			AA_Span s = { y_, x0_, x1_, 256 };
+			_capShape->plots.push_back( s );
+			return;
+		}
+		if ( _masked )
+		{
+			memset( &_mask[y_ * _w + x0_], 255, x1_ - x0_ + 1 );
+			if ( x0_ < _maskX0[y_] ) _maskX0[y_] = x0_;
+			if ( x1_ > _maskX1[y_] ) _maskX1[y_] = x1_;
+			if ( y_ < _minY ) _minY = y_;
+			if ( y_ > _maxY ) _maxY = y_;
+			return;
+		}
+		add_dirty( x0_, x1_, y_ );
+		fill_span( _buf + y_ * 4 * _w + x0_ * 4, x1_ - x0_ + 1 );
+	}
+
+	void flush()
+	{
+		// composite the coverage collected in the mask
+		if ( _masked )
+			composite_mask();
+		commit_dirty();
+	}
+
+	// the canvas the bresenham hooks currently draw into (per thread)
+	static Fl_AA_Canvas *&current()
+	{
+		static thread_local Fl_AA_Canvas *canvas = 0;
+		return canvas;
+	}
+
+private:
+	void share( const Fl_AA_Canvas &c_ )
 	{
-		if ( x <  0 || y < 0 || x >= W || y >= H )
+		// make this a view drawing into the buffer of another canvas
+		attach( c_._buf, c_._w, c_._h );
+		_blend = c_._blend;
+		_cache = c_._cache;
+		_gamma = c_._gamma;
+		memcpy( _lut, c_._lut, sizeof( _lut ) );
+	}
+
+	void add( AA_Command &c_ )
+	{
+		// rasterize primitive now or record it in batch mode
+		c_.r = _r;
+		c_.g = _g;
+		c_.b = _b;
+		if ( !_batch )
+		{
+			_prevValid = false;
+			execute( c_, *this );
 			return;
-		uchar *pixel = OffScreenBuf + y * 4 * W + x * 4;
-		Fl::get_color( fl_color(), pixel[0], pixel[1], pixel[2] );
-		pixel[3] = 255 - alpha;
+		}
+		c_.clip.x0 = _cx0;
+		c_.clip.y0 = _cy0;
+		c_.clip.x1 = _cx1;
+		c_.clip.y1 = _cy1;
+		AA_Box &b = c_.box;
+		b = bounds( c_, *this );
+		b.x0 = std::max( b.x0, c_.clip.x0 );
+		b.y0 = std::max( b.y0, c_.clip.y0 );
+		b.x1 = std::min( b.x1, c_.clip.x1 );
+		b.y1 = std::min( b.y1, c_.clip.y1 );
+		if ( b.x0 <= b.x1 && b.y0 <= b.y1 )
+			_commands.push_back( c_ );
 	}
+
+	void rasterize( int threads_ )
+	{
+		// rasterize the recorded primitives tile by tile
+		if ( _commands.empty() || !_buf )
+			return;
+		flush();
+		enum { TILE = 64 };
+		int tw = ( _w + TILE - 1 ) / TILE;
+		int th = ( _h + TILE - 1 ) / TILE;
+
+		// recording order or grouped by color
+		std::vector<int> order( _commands.size() );
+		for ( size_t i = 0; i < order.size(); i++ )
+			order[i] = i;
+		if ( _group )
+			std::stable_sort( order.begin(), order.end(), [this]( int a_, int b_ )
+			{
+				const AA_Command &a = _commands[a_];
+				const AA_Command &b = _commands[b_];
+				return ( a.r << 16 | a.g << 8 | a.b ) < ( b.r << 16 | b.g << 8 | b.b );
+			} );
+
+		// bin primitives into tiles
+		std::vector<std::vector<int> > bins( tw * th );
+		for ( size_t o = 0; o < order.size(); o++ )
+		{
+			int i = order[o];
+			const AA_Command &c = _commands[i];
+			if ( c.type == AA_POLYLINE )
+			{
+				// only the tiles touched by the chunks of the polyline
+				for ( int k = 0; k < ( c.p[1] + POLY_CHUNK - 1 ) / POLY_CHUNK; k++ )
+				{
+					AA_Box b = _boxes[c.p[2] + k];
+					b.x0 = std::max( b.x0, c.box.x0 );
+					b.y0 = std::max( b.y0, c.box.y0 );
+					b.x1 = std::min( b.x1, c.box.x1 );
+					b.y1 = std::min( b.y1, c.box.y1 );
+					for ( int ty = b.y0 / TILE; ty <= b.y1 / TILE; ty++ )
+						for ( int tx = b.x0 / TILE; b.y0 <= b.y1 && tx <= b.x1 / TILE; tx++ )
+							if ( bins[ty * tw + tx].empty() || bins[ty * tw + tx].back() != i )
+								bins[ty * tw + tx].push_back( i );
+				}
+				continue;
+			}
+			const AA_Box &b = c.box;
+			for ( int ty = b.y0 / TILE; ty <= b.y1 / TILE; ty++ )
+			{
+				int x0 = b.x0;
+				int x1 = b.x1;
+				if ( c.type == AA_LINE && c.p[1] != c.p[3] )
+				{
+					// only the tiles along the line: x range of the line
+					// within the tile row extended by the line's half width
+					const int *p = c.p;
+					double d = ceil( c.width / 2 ) + 1;
+					double ya = std::max( ty * TILE - d, (double)std::min( p[1], p[3] ) );
+					double yb = std::min( ty * TILE + TILE - 1 + d, (double)std::max( p[1], p[3] ) );
+					double m = (double)( p[2] - p[0] ) / ( p[3] - p[1] );
+					double xa = p[0] + ( ya - p[1] ) * m;
+					double xb = p[0] + ( yb - p[1] ) * m;
+					x0 = std::max( x0, (int)floor( std::min( xa, xb ) - d ) );
+					x1 = std::min( x1, (int)ceil( std::max( xa, xb ) + d ) );
+				}
+				for ( int tx = x0 / TILE; tx <= x1 / TILE; tx++ )
+					bins[ty * tw + tx].push_back( i );
+			}
+		}
+		std::vector<int> tiles;
+		for ( int t = 0; t < tw * th; t++ )
+			if ( !bins[t].empty() )
+				tiles.push_back( t );
+		std::vector<AA_Box> drawn( tiles.size() );
+
+		// let the workers fetch tiles until all are done
+		std::atomic<size_t> next( 0 );
+		auto worker = [&]()
+		{
+			Fl_AA_Canvas view;
+			view.share( *this );
+			view._merge = _group;	// (flushed by clip/color changes only)
+			for ( size_t i; ( i = next++ ) < tiles.size(); )
+			{
+				int t = tiles[i];
+				AA_Box tile = { t % tw * TILE, t / tw * TILE,
+				                std::min( t % tw * TILE + TILE, _w ) - 1,
+				                std::min( t / tw * TILE + TILE, _h ) - 1 };
+				for ( size_t j = 0; j < bins[t].size(); j++ )
+				{
+					const AA_Command &c = _commands[bins[t][j]];
+					AA_Box clip = { std::max( tile.x0, c.clip.x0 ), std::max( tile.y0, c.clip.y0 ),
+					                std::min( tile.x1, c.clip.x1 ), std::min( tile.y1, c.clip.y1 ) };
+					AA_Box prev = { view._cx0, view._cy0, view._cx1, view._cy1 };
+					if ( j == 0 || !( clip == prev ) )
+						view.clip( clip.x0, clip.y0, clip.x1 - clip.x0 + 1, clip.y1 - clip.y0 + 1 );
+					if ( j == 0 || c.r != view._r || c.g != view._g || c.b != view._b )
+						view.color( c.r, c.g, c.b );
+					view.execute( c, *this );
+				}
+				view.flush();
+				int x, y, w, h;
+				drawn[i].x0 = INT_MAX;
+				if ( view.dirty( x, y, w, h ) )
+				{
+					AA_Box b = { x, y, x + w - 1, y + h - 1 };
+					drawn[i] = b;
+				}
+				view.reset_dirty();
+			}
+		};
+		int n = threads_ > 0 ? threads_ : std::thread::hardware_concurrency();
+		n = std::max( 1, std::min( n, (int)tiles.size() ) );
+		std::vector<std::thread> pool;
+		for ( int i = 1; i < n; i++ )
+			pool.push_back( std::thread( worker ) );
+		worker();
+		for ( size_t i = 0; i < pool.size(); i++ )
+			pool[i].join();
+
+		// collect the areas drawn to
+		for ( size_t i = 0; i < drawn.size(); i++ )
+			if ( drawn[i].x0 != INT_MAX )
+				add_dirty_box( drawn[i] );
+	}
+
+
+	static AA_Box bounds( const AA_Command &c_, const Fl_AA_Canvas &rec_ )
+	{
+		// bounding box of all pixels a primitive can draw
+		// (rec_: canvas holding the point lists of the primitive)
+		AA_Box b;
+		const int *p = c_.p;
+		switch ( c_.type )
+		{
+			case AA_LINE:
+			{
+				int d = (int)ceil( c_.width / 2 ) + 1;
+				b.x0 = std::min( p[0], p[2] ) - d;
+				b.y0 = std::min( p[1], p[3] ) - d;
+				b.x1 = std::max( p[0], p[2] ) + d;
+				b.y1 = std::max( p[1], p[3] ) + d;
+				break;
+			}
+			case AA_CIRCLE:
+			case AA_PIE:
+				b.x0 = p[0] - p[2] - 1;
+				b.y0 = p[1] - p[2] - 1;
+				b.x1 = p[0] + p[2] + 1;
+				b.y1 = p[1] + p[2] + 1;
+				break;
+			case AA_ELLIPSE:
+			case AA_PIE_ELLIPSE:
+				b.x0 = p[0] - 1;
+				b.y0 = p[1] - 1;
+				b.x1 = p[0] + p[2] + 1;
+				b.y1 = p[1] + p[3] + 1;
+				break;
+			case AA_BEZIER:
+				// (curve is inside the hull of its control points)
+				b.x0 = std::min( p[0], std::min( p[2], p[4] ) ) - 1;
+				b.y0 = std::min( p[1], std::min( p[3], p[5] ) ) - 1;
+				b.x1 = std::max( p[0], std::max( p[2], p[4] ) ) + 1;
+				b.y1 = std::max( p[1], std::max( p[3], p[5] ) ) + 1;
+				break;
+			case AA_RATIONAL_BEZIER:
+			case AA_CUBIC_BEZIER:
+			{
+				int n = c_.type == AA_CUBIC_BEZIER ? 4 : 3;
+				b.x0 = b.x1 = p[0];
+				b.y0 = b.y1 = p[1];
+				for ( int i = 1; i < n; i++ )
+				{
+					b.x0 = std::min( b.x0, p[2 * i] );
+					b.y0 = std::min( b.y0, p[2 * i + 1] );
+					b.x1 = std::max( b.x1, p[2 * i] );
+					b.y1 = std::max( b.y1, p[2 * i + 1] );
+				}
+				b.x0--;
+				b.y0--;
+				b.x1++;
+				b.y1++;
+				break;
+			}
+			case AA_ROTATED_ELLIPSE:
+			{
+				int r = std::max( abs( p[2] ), abs( p[3] ) ) + 2;
+				b.x0 = p[0] - r;
+				b.y0 = p[1] - r;
+				b.x1 = p[0] + r;
+				b.y1 = p[1] + r;
+				break;
+			}
+			case AA_SPLINE:
+			{
+				// the spline can overshoot its points, but its bezier
+				// control points stay within twice their extent
+				const int *xy = &rec_._points[p[0]];
+				b.x0 = b.x1 = xy[0];
+				b.y0 = b.y1 = xy[1];
+				for ( int i = 1; i < p[1]; i++ )
+				{
+					b.x0 = std::min( b.x0, xy[2 * i] );
+					b.y0 = std::min( b.y0, xy[2 * i + 1] );
+					b.x1 = std::max( b.x1, xy[2 * i] );
+					b.y1 = std::max( b.y1, xy[2 * i + 1] );
+				}
+				int dx = ( b.x1 - b.x0 ) / 2 + 2;
+				int dy = ( b.y1 - b.y0 ) / 2 + 2;
+				b.x0 -= dx;
+				b.y0 -= dy;
+				b.x1 += dx;
+				b.y1 += dy;
+				break;
+			}
+			case AA_LINE_FIXED:
+			{
+				int d = (int)ceil( c_.width / 2 ) + 2;
+				b.x0 = ( std::min( p[0], p[2] ) >> 8 ) - d;
+				b.y0 = ( std::min( p[1], p[3] ) >> 8 ) - d;
+				b.x1 = ( std::max( p[0], p[2] ) >> 8 ) + d;
+				b.y1 = ( std::max( p[1], p[3] ) >> 8 ) + d;
+				break;
+			}
+			case AA_CIRCLE_FIXED:
+			{
+				int d = (int)ceil( c_.width / 2 ) + 2;
+				b.x0 = ( ( p[0] - p[2] ) >> 8 ) - d;
+				b.y0 = ( ( p[1] - p[2] ) >> 8 ) - d;
+				b.x1 = ( ( p[0] + p[2] ) >> 8 ) + d;
+				b.y1 = ( ( p[1] + p[2] ) >> 8 ) + d;
+				break;
+			}
+			case AA_POLYLINE:
+				b = rec_._boxes[p[2]];
+				for ( int k = 1; k < ( p[1] + POLY_CHUNK - 1 ) / POLY_CHUNK; k++ )
+					b.merge( rec_._boxes[p[2] + k] );
+				break;
+		}
+		if ( c_.width > 1 && ( c_.type == AA_CIRCLE || c_.type == AA_ELLIPSE || c_.type == AA_RATIONAL_BEZIER ||
+		                       c_.type == AA_CUBIC_BEZIER || c_.type == AA_ROTATED_ELLIPSE ) )
+		{
+			// stroked outline
+			int d = (int)ceil( c_.width / 2 ) + 1;
+			b.x0 -= d;
+			b.y0 -= d;
+			b.x1 += d;
+			b.y1 += d;
+		}
+		return b;
+	}
+
+	void execute( const AA_Command &c_, const Fl_AA_Canvas &rec_ )
+	{
+		// rasterize a primitive, skipping what is outside the clip rectangle
+		AA_Box b = bounds( c_, rec_ );
+		if ( b.x1 < _cx0 || b.y1 < _cy0 || b.x0 > _cx1 || b.y0 > _cy1 )
+			return;
+		Primitive prim( this );
+		if ( _cache && !_capture && !_merge && AA_Shape_Cache::cacheable( c_ ) )
+		{
+			stamp( *cached_shape( c_, rec_ ), c_.p[0], c_.p[1] );
+			return;
+		}
+		if ( _merge )
+			use_mask();	// (primitives of a color composited together)
+		const int *p = c_.p;
+		int cx0 = _cx0, cy0 = _cy0, cx1 = _cx1, cy1 = _cy1;
+		if ( c_.width > 1 && ( c_.type == AA_RATIONAL_BEZIER || c_.type == AA_CUBIC_BEZIER ||
+		                       c_.type == AA_ROTATED_ELLIPSE ) )
+		{
+			// thick curves are drawn as polyline
+			flatten( c_, _flat );
+			plot_polyline( &_flat[0], (int)_flat.size() / 2, c_.width );
+			return;
+		}
+		switch ( c_.type )
+		{
+			case AA_LINE:
+				c_.width == 1. ? plotLineAAClip( p[0], p[1], p[2], p[3], cx0, cy0, cx1, cy1 ) :
+				                 plotLineWidthClip( p[0], p[1], p[2], p[3], c_.width, cx0, cy0, cx1, cy1 );
+				break;
+			case AA_CIRCLE:
+				c_.width > 1 ? plotEllipseRectWidthClip( p[0] - p[2], p[1] - p[2], p[0] + p[2], p[1] + p[2], c_.width, cx0, cy0, cx1, cy1 ) :
+				               plotCircleAAClip( p[0], p[1], p[2], cx0, cy0, cx1, cy1 );
+				break;
+			case AA_ELLIPSE:
+				c_.width > 1 ? plotEllipseRectWidthClip( p[0], p[1], p[0] + p[2] - 1, p[1] + p[3] - 1, c_.width, cx0, cy0, cx1, cy1 ) :
+				p[2] == p[3] ? plotCircleAAClip( p[0] + p[2] / 2, p[1] + p[3] / 2, p[2] / 2, cx0, cy0, cx1, cy1 ) :
+				               plotEllipseRectAAClip( p[0], p[1], p[0] + p[2] - 1, p[1] + p[3] - 1, cx0, cy0, cx1, cy1 );
+				break;
+			case AA_PIE:
+				plotFilledCircleAAClip( p[0], p[1], p[2], cx0, cy0, cx1, cy1 );
+				break;
+			case AA_PIE_ELLIPSE:
+				p[2] == p[3] ? plotFilledCircleAAClip( p[0] + p[2] / 2, p[1] + p[3] / 2, p[2] / 2, cx0, cy0, cx1, cy1 ) :
+				               plotFilledEllipseRectAAClip( p[0], p[1], p[0] + p[2] - 1, p[1] + p[3] - 1, cx0, cy0, cx1, cy1 );
+				break;
+			case AA_BEZIER:
+				plotQuadBezierAA( p[0], p[1], p[2], p[3], p[4], p[5] );
+				break;
+			case AA_RATIONAL_BEZIER:
+				plotQuadRationalBezierAA( p[0], p[1], p[2], p[3], p[4], p[5], c_.param );
+				break;
+			case AA_CUBIC_BEZIER:
+				plotCubicBezierAA( p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7] );
+				break;
+			case AA_ROTATED_ELLIPSE:
+				plotRotatedEllipseAA( p[0], p[1], abs( p[2] ), abs( p[3] ), c_.param * acos( -1. ) / 180 );
+				break;
+			case AA_SPLINE:
+			{
+				// (the bresenham spline functions destroy their input)
+				int n = p[1] - 1;
+				std::vector<int> x( n + 1 ), y( n + 1 );
+				for ( int i = 0; i <= n; i++ )
+				{
+					x[i] = rec_._points[p[0] + 2 * i];
+					y[i] = rec_._points[p[0] + 2 * i + 1];
+				}
+				if ( n < 2 )
+					plotLineAA( x[0], y[0], x[n], y[n] );
+				else if ( n == 2 || p[2] == 2 )
+					plotQuadSplineAA( n, &x[0], &y[0] );
+				else
+					plotCubicSplineAA( n, &x[0], &y[0] );
+				break;
+			}
+			case AA_POLYLINE:
+				execute_polyline( c_, rec_ );
+				break;
+			case AA_LINE_FIXED:
+				c_.width == 1. ? plotLineAAFixed( p[0], p[1], p[2], p[3], cx0, cy0, cx1, cy1 ) :
+				                 plotLineWidthFixed( p[0], p[1], p[2], p[3], c_.width, cx0, cy0, cx1, cy1 );
+				break;
+			case AA_CIRCLE_FIXED:
+				c_.width > 1 ? plotCircleWidthFixed( p[0], p[1], p[2], c_.width, cx0, cy0, cx1, cy1 ) :
+				               plotCircleAAFixed( p[0], p[1], p[2], cx0, cy0, cx1, cy1 );
+				break;
+		}
+	}
+
+	void execute_polyline( const AA_Command &c_, const Fl_AA_Canvas &rec_ )
+	{
+		// rasterize the visible chunks of a polyline
+		plot_polyline( &rec_._points[c_.p[0]], c_.p[1], c_.width, &rec_._boxes[c_.p[2]] );
+	}
+
+	void plot_polyline( const int *xy_, int n_, float width_, const AA_Box *boxes_ = 0 )
+	{
+		// rasterize a polyline, skipping the chunks whose bounding box
+		// boxes_[k] is outside the clip rectangle (if boxes_ given)
+		int r = width_ > 2 ? (int)( width_ / 2 ) : 0;	// join radius
+		use_mask();	// (segments and joins overlap)
+		if ( n_ == 1 )
+			plotLineAAClip( xy_[0], xy_[1], xy_[0], xy_[1], _cx0, _cy0, _cx1, _cy1 );
+		for ( int k = 0; k * POLY_CHUNK < n_ - 1; k++ )
+		{
+			const AA_Box *b = boxes_ ? boxes_ + k : 0;
+			if ( b && ( b->x1 < _cx0 || b->y1 < _cy0 || b->x0 > _cx1 || b->y0 > _cy1 ) )
+				continue;
+			int end = std::min( k * POLY_CHUNK + POLY_CHUNK, n_ - 1 );
+			for ( int i = k * POLY_CHUNK; i < end; i++ )
+			{
+				const int *p = xy_ + 2 * i;
+				width_ == 1. ? plotLineAAClip( p[0], p[1], p[2], p[3], _cx0, _cy0, _cx1, _cy1 ) :
+				               plotLineWidthClip( p[0], p[1], p[2], p[3], width_, _cx0, _cy0, _cx1, _cy1 );
+				if ( r && i > 0 )
+					plotFilledCircleAAClip( p[0], p[1], r, _cx0, _cy0, _cx1, _cy1 );
+			}
+		}
+	}
+
+	void use_mask()
+	{
+		// collect the coverage in the mask, so overlapping pixels get
+		// the max. coverage (polylines and grouped primitives)
+		if ( _capture )
+		{
+			_capShape->masked = true;
+			return;
+		}
+		if ( _mask.size() != (size_t)_w * _h )
+		{
+			_mask.assign( (size_t)_w * _h, 0 );
+			_maskX0.assign( _h, _w );
+			_maskX1.assign( _h, -1 );
+		}
+		_masked = true;
+	}
+
+	AA_Shape_Cache::Shape cached_shape( const AA_Command &c_, const Fl_AA_Canvas &rec_ )
+	{
+		// the rasterized primitive from the shape cache, a missing one
+		// is rasterized, capturing its plotted pixels, and added
+		AA_Shape_Cache::Key k = AA_Shape_Cache::key( c_ );
+		AA_Shape_Cache::Shape cached = _cache->find( k );
+		if ( cached )
+			return cached;
+
+		// rasterize the primitive moved to the origin..
+		AA_Box b = bounds( c_, rec_ );
+		int w = b.x1 - b.x0 + 1;
+		int h = b.y1 - b.y0 + 1;
+		AA_Command c = c_;
+		c.p[0] -= b.x0;
+		c.p[1] -= b.y0;
+		std::shared_ptr<AA_Shape> shape( new AA_Shape );
+		_capShape = shape.get();
+		AA_Box clip = { _cx0, _cy0, _cx1, _cy1 };
+		_cx0 = _cy0 = 0;
+		_cx1 = w - 1;
+		_cy1 = h - 1;
+		_capture = true;
+		execute( c, rec_ );
+		_capture = false;
+		_cx0 = clip.x0;
+		_cy0 = clip.y0;
+		_cx1 = clip.x1;
+		_cy1 = clip.y1;
+
+		// ..and keep its plotted pixels relative to its position
+		int dx = b.x0 - c_.p[0];
+		int dy = b.y0 - c_.p[1];
+		for ( size_t i = 0; i < shape->plots.size(); i++ )
+		{
+			AA_Span &s = shape->plots[i];
+			s.y += dy;
+			s.x0 += dx;
+			s.x1 += dx;
+		}
+		_cache->insert( k, shape );
+		return shape;
+	}
+
+	void stamp( const AA_Shape &s_, int x_, int y_ )
+	{
+		// replay a rasterized shape at position x_/y_ (clipped)
+		if ( s_.masked )
+			use_mask();
+		for ( size_t i = 0; i < s_.plots.size(); i++ )
+		{
+			const AA_Span &s = s_.plots[i];
+			s.cov == 256 ? hline( x_ + s.x0, x_ + s.x1, y_ + s.y ) : pixel( x_ + s.x0, y_ + s.y, (uchar)s.cov );
+		}
+	}
+
+	static void flatten( const AA_Command &c_, std::vector<int> &xy_ )
+	{
+		// approximate a curve by a polyline with segments of a few pixels
+		const int *p = c_.p;
+		xy_.clear();
+		if ( c_.type == AA_ROTATED_ELLIPSE )
+		{
+			double a = abs( p[2] ), b = abs( p[3] );
+			double phi = c_.param * acos( -1. ) / 180;
+			int n = std::min( std::max( (int)( 2 * acos( -1. ) * std::max( a, b ) / 4 ), 8 ), 4096 );
+			for ( int i = 0; i <= n; i++ )
+			{
+				double t = 2 * acos( -1. ) * i / n;
+				double x = a * cos( t ), y = b * sin( t );
+				// (rounded relative to the center, so moving the center
+				// moves all points by the same amount)
+				xy_.push_back( p[0] + (int)floor( x * cos( phi ) - y * sin( phi ) + .5 ) );
+				xy_.push_back( p[1] + (int)floor( x * sin( phi ) + y * cos( phi ) + .5 ) );
+			}
+			return;
+		}
+		int m = c_.type == AA_CUBIC_BEZIER ? 4 : 3;	// control points
+		double len = 0;
+		for ( int i = 1; i < m; i++ )
+			len += hypot( p[2 * i] - p[2 * i - 2], p[2 * i + 1] - p[2 * i - 1] );
+		int n = std::min( std::max( (int)( len / 4 ), 1 ), 4096 );
+		for ( int i = 0; i <= n; i++ )
+		{
+			double t = (double)i / n, s = 1 - t, x, y;
+			if ( m == 4 )
+			{
+				x = s * s * s * p[0] + 3 * s * s * t * p[2] + 3 * s * t * t * p[4] + t * t * t * p[6];
+				y = s * s * s * p[1] + 3 * s * s * t * p[3] + 3 * s * t * t * p[5] + t * t * t * p[7];
+			}
+			else
+			{
+				double w = 2 * c_.param * s * t;
+				double d = s * s + w + t * t;
+				x = ( s * s * p[0] + w * p[2] + t * t * p[4] ) / d;
+				y = ( s * s * p[1] + w * p[3] + t * t * p[5] ) / d;
+			}
+			xy_.push_back( (int)floor( x + .5 ) );
+			xy_.push_back( (int)floor( y + .5 ) );
+		}
+	}
+
+	enum { MAX_DIRTY = 8 };	// max. number of dirty boxes tracked
+	enum { POLY_CHUNK = 64 };	// polyline segments per bounding box
+
+	void reset_dirty()
+	{
+		_dirty.clear();
+		_dx0 = _dy0 = INT_MAX;
+		_dx1 = _dy1 = INT_MIN;
+	}
+	void add_dirty( int x0_, int x1_, int y_ )
+	{
+		// extend bounding box of the current primitive
+		if ( x0_ < _dx0 ) _dx0 = x0_;
+		if ( x1_ > _dx1 ) _dx1 = x1_;
+		if ( y_ < _dy0 ) _dy0 = y_;
+		if ( y_ > _dy1 ) _dy1 = y_;
+	}
+	void commit_dirty()
+	{
+		// add bounding box of the finished primitive to the dirty boxes
+		if ( _dx0 > _dx1 )
+			return;
+		AA_Box box = { _dx0, _dy0, _dx1, _dy1 };
+		_dx0 = _dy0 = INT_MAX;
+		_dx1 = _dy1 = INT_MIN;
+		add_dirty_box( box );
+	}
+	void add_dirty_box( AA_Box box )
+	{
+		// add box to the dirty boxes, keeping them disjoint
+		// (each pixel must be drawn only once)
+		for ( ;; )
+		{
+			size_t i = 0;
+			while ( i < _dirty.size() && !box.touches( _dirty[i] ) )
+				i++;
+			if ( i == _dirty.size() && _dirty.size() < MAX_DIRTY )
+				break;
+			if ( i == _dirty.size() )
+			{
+				// too many boxes: merge with the one growing least
+				long best = LONG_MAX;
+				for ( size_t j = 0; j < _dirty.size(); j++ )
+				{
+					AA_Box u = box;
+					u.merge( _dirty[j] );
+					long growth = u.area() - _dirty[j].area();
+					if ( growth < best )
+					{
+						best = growth;
+						i = j;
+					}
+				}
+			}
+			box.merge( _dirty[i] );
+			_dirty.erase( _dirty.begin() + i );
+		}
+		_dirty.push_back( box );
+	}
+
+	struct Primitive
+	{
+		// directs the hooks to a canvas while a primitive is rasterized
+		Primitive( Fl_AA_Canvas *c_ ) :
+			_canvas( c_ ),
+			_prev( current() )
+		{
+			if ( !_canvas->_merge )
+				_canvas->flush();
+			current() = _canvas;
+		}
+		~Primitive()
+		{
+			if ( !_canvas->_merge )
+				_canvas->flush();
+			current() = _prev;
+		}
+		Fl_AA_Canvas *_canvas;
+		Fl_AA_Canvas *_prev;
+	};
+
+	void composite_mask()
+	{
+		// composite the runs of covered pixels of the mask and clear it
+		for ( int y = _minY; y <= _maxY; y++ )
+		{
+			int x0 = _maskX0[y];
+			int x1 = _maskX1[y];
+			if ( x0 > x1 )
+				continue;
+			uchar *m = &_mask[y * _w];
+			for ( int x = x0; x <= x1; )
+			{
+				for ( ; x <= x1 && !m[x]; x++ ) {}
+				int a = x;
+				for ( ; x <= x1 && m[x]; x++ ) {}
+				if ( a < x )
+				{
+					add_dirty( a, x - 1, y );
+					blend_span( _buf + y * 4 * _w + a * 4, m + a, x - a );
+				}
+			}
+			memset( m + x0, 0, x1 - x0 + 1 );
+			_maskX0[y] = _w;
+			_maskX1[y] = -1;
+		}
+		_minY = _h;
+		_maxY = -1;
+		_masked = false;
+	}
+
+	void fill_span( uchar *pixel_, int n_ )
+	{
+		// set n_ pixels to current color (opaque, which is the
+		// same in both blend modes) with 32 bit stores
+		uchar c[4] = { _r, _g, _b, 255 };
+		uint32_t v;
+		memcpy( &v, c, 4 );
+		std::fill_n( (uint32_t *)pixel_, n_, v );
+	}
+
+	void blend_span( uchar *pixel_, const uchar *cov_, int n_ )
+	{
+		// blend n_ pixels in current color with coverage values cov_
+		// (mapped to alpha by the gamma table)
+		if ( _blend == FL_AA_OVER )
+		{
+			for ( ; n_-- > 0; pixel_ += 4 )
+			{
+				unsigned a = _lut[*cov_++];
+				unsigned ia = 255 - a;
+				pixel_[0] = aa_div255( _r * a ) + aa_div255( pixel_[0] * ia );
+				pixel_[1] = aa_div255( _g * a ) + aa_div255( pixel_[1] * ia );
+				pixel_[2] = aa_div255( _b * a ) + aa_div255( pixel_[2] * ia );
+				pixel_[3] = a + aa_div255( pixel_[3] * ia );
+			}
+			return;
+		}
+		for ( ; n_-- > 0; pixel_ += 4 )
+		{
+			pixel_[0] = _r;
+			pixel_[1] = _g;
+			pixel_[2] = _b;
+			pixel_[3] = _lut[*cov_++];
+		}
+	}
+
+	void premultiply( const uchar *src_, int ld_, int w_, int h_ )
+	{
+		// convert straight alpha area of buffer to premultiplied alpha
+		_scratch.resize( w_ * h_ * 4 );
+		uchar *dst = &_scratch[0];
+		for ( int y = 0; y < h_; y++, src_ += ld_ )
+		{
+			const uchar *src = src_;
+			for ( int x = 0; x < w_; x++, src += 4, dst += 4 )
+			{
+				unsigned a = src[3];
+				dst[0] = aa_div255( src[0] * a );
+				dst[1] = aa_div255( src[1] * a );
+				dst[2] = aa_div255( src[2] * a );
+				dst[3] = a;
+			}
+		}
+	}
+
+	void unpremultiply( const uchar *src_, int ld_, int w_, int h_ )
+	{
+		// convert premultiplied area of buffer to straight alpha
+		_scratch.resize( w_ * h_ * 4 );
+		uchar *dst = &_scratch[0];
+		for ( int y = 0; y < h_; y++, src_ += ld_ )
+		{
+			const uchar *src = src_;
+			for ( int x = 0; x < w_; x++, src += 4, dst += 4 )
+			{
+				unsigned a = src[3];
+				dst[3] = a;
+				if ( !a )
+				{
+					dst[0] = dst[1] = dst[2] = 0;
+					continue;
+				}
+				dst[0] = std::min( 255u, ( src[0] * 255 + a / 2 ) / a );
+				dst[1] = std::min( 255u, ( src[1] * 255 + a / 2 ) / a );
+				dst[2] = std::min( 255u, ( src[2] * 255 + a / 2 ) / a );
+			}
+		}
+	}
+
+private:
+	uchar *_buf;
+	int _w, _h;
+	int _cx0, _cy0, _cx1, _cy1;	// clip rectangle (inclusive)
+	uchar _r, _g, _b;	// current color
+	int _blend;
+	float _gamma;
+	uchar _lut[256];	// coverage -> alpha
+	int _minY, _maxY;	// row range of the mask
+	int _dx0, _dy0, _dx1, _dy1;	// bounding box of current primitive
+	std::vector<AA_Box> _dirty;	// areas drawn to since last clear
+	std::vector<uchar> _scratch;	// converted copy of a dirty area
+	bool _shared;	// buffer belongs to another canvas or the caller
+	bool _batch;	// record primitives
+	bool _frame;	// recording a frame (begin_frame())
+	bool _group;	// group recorded primitives by color
+	bool _merge;	// don't flush after each primitive (grouped colors)
+	std::vector<AA_Command> _commands;	// recorded primitives
+	std::vector<int> _points;	// point lists of recorded splines/polylines
+	std::vector<AA_Box> _boxes;	// bounding boxes of polyline chunks
+	bool _prevValid;	// buffer holds the result of previous frame:
+	std::vector<AA_Command> _prevCommands;	// its primitives
+	std::vector<int> _prevPoints;
+	std::vector<AA_Box> _prevBoxes;
+	bool _masked;	// collect coverage in the mask (polylines)
+	std::vector<uchar> _mask;	// max. coverage of each pixel
+	std::vector<int> _maskX0, _maskX1;	// covered columns of mask rows
+	std::vector<int> _flat;	// points of a flattened thick curve
+	AA_Shape_Cache *_cache;	// rasterized shapes (or 0)
+	bool _capture;	// capture the plotted pixels (shape cache)
+	AA_Shape *_capShape;	// the shape rasterized
+};
+
+
+static void setPixelAA( int x, int y, unsigned char alpha )
+{
+	// draw a pixel in current color at x/y with alpha value
+	Fl_AA_Canvas *canvas = Fl_AA_Canvas::current();
+	if ( canvas )
+		canvas->pixel( x, y, alpha );
 }
 
 static void setPixel( int x, int y )
@@ -42,53 +1548,247 @@ static void setPixel( int x, int y )
 	setPixelAA( x, y, 0 );
 }
 
+static void setHLine( int x0, int x1, int y )
+{
+	// draw an opaque horizontal line (interior of filled shapes)
+	Fl_AA_Canvas *canvas = Fl_AA_Canvas::current();
+	if ( canvas )
+		canvas->hline( x0, x1, y );
+}
+
+
+// fl_draw style interface
+//    Uses a canvas per translation unit that draws in fl_color().
+//    In persistent mode the buffer is kept from frame to frame.
+static Fl_AA_Canvas AA_Canvas;
+static bool AA_Persistent = false;
+
+static void fl_aa_persistent( bool persistent_ )
+{
+	AA_Persistent = persistent_;
+	if ( !AA_Persistent )
+		AA_Canvas.release();
+}
+
+static bool fl_aa_persistent()
+{
+	return AA_Persistent;
+}
+
+// In batch mode the primitives are rasterized by fl_end_aa() using
+// worker threads (0: one per cpu core).
+static bool AA_Batch = false;
+static int AA_Threads = 0;
+
+static void fl_aa_batch( bool batch_, int threads_ = 0 )
+{
+	AA_Batch = batch_;
+	AA_Threads = threads_;
+}
+
+static bool fl_aa_batch()
+{
+	return AA_Batch;
+}
+
+// In record mode each frame is recorded and rasterized by fl_end_aa()
+// like in batch mode, but a frame with the same primitives as the
+// previous one isn't rasterized again (the buffer is kept from frame to
+// frame). Grouping by color lets fl_end_aa() reorder the primitives
+// (see Fl_AA_Canvas::group_colors()).
+static bool AA_Record = false;
+
+static void fl_aa_record( bool record_, bool group_colors_ = false )
+{
+	AA_Record = record_;
+	AA_Canvas.group_colors( group_colors_ );
+}
+
+static bool fl_aa_record()
+{
+	return AA_Record;
+}
+
+// With a shape cache, circles, ellipses and pies of the same size (and
+// stroke width) are rasterized once and then composited from the cache
+// (capacity in bytes, 0: no cache).
+static AA_Shape_Cache AA_Shapes;
+
+static void fl_aa_shape_cache( size_t capacity_ )
+{
+	AA_Shapes.capacity( capacity_ );
+	AA_Canvas.shape_cache( capacity_ ? &AA_Shapes : 0 );
+}
+
+static AA_Shape_Cache &fl_aa_shape_cache()
+{
+	// (for the hit/miss counters)
+	return AA_Shapes;
+}
+
+static void fl_aa_gamma( float gamma_ )
+{
+	AA_Canvas.gamma( gamma_ );
+}
+
+static float fl_aa_gamma()
+{
+	return AA_Canvas.gamma();
+}
+
+static void fl_aa_blend( int blend_ )
+{
+	AA_Canvas.blend( blend_ );
+}
+
+static int fl_aa_blend()
+{
+	return AA_Canvas.blend();
+}
+
+// Instead of the current FLTK surface fl_begin_aa()/fl_end_aa() can draw
+// into an image buffer of the caller, which needs no display connection
+// (e.g. offscreen rendering of thumbnails): RGBA buffers (d_ = 4) are
+// drawn into directly, onto RGB buffers (d_ = 3) fl_end_aa() composites
+// the primitives (record mode doesn't apply).
+static uchar *AA_Target = 0;
+static int AA_Target_D = 4;
+
+static void fl_begin_aa( uchar *buf_, int w_, int h_, int d_ = 4 )
+{
+	AA_Target = buf_;
+	AA_Target_D = d_;
+	if ( d_ == 4 )
+		AA_Canvas.attach( buf_, w_, h_ );
+	else
+		AA_Persistent ? AA_Canvas.begin( w_, h_ ) :
+		                AA_Canvas.size( w_, h_ );
+	if ( AA_Batch || AA_Record )
+		AA_Canvas.begin_batch();
+}
 
 static void fl_begin_aa( int w_, int h_ )
 {
-	OffScreenBuf = new uchar[w_ * h_ * 4];
-	W = w_;
-	H = h_;
-	memset( OffScreenBuf, 0 , W * H * 4 );
+	if ( AA_Record )
+	{
+		AA_Canvas.begin_frame( w_, h_ );
+		return;
+	}
+	AA_Persistent ? AA_Canvas.begin( w_, h_ ) :
+	                AA_Canvas.size( w_, h_ );
+	if ( AA_Batch )
+		AA_Canvas.begin_batch();
 }
 
 static void fl_end_aa( int x_ = 0, int y_ = 0 )
 {
-	if ( !OffScreenBuf )
+	if ( AA_Target )
+	{
+		// (x_/y_ don't apply)
+		if ( AA_Canvas.batch() )
+			AA_Canvas.end_batch( AA_Threads );
+		AA_Target_D == 4 ? AA_Canvas.flush() :
+		                   AA_Canvas.composite( AA_Target, AA_Target_D );
+		if ( AA_Target_D == 4 || !AA_Persistent )
+			AA_Canvas.release();
+		AA_Target = 0;
 		return;
-	Fl_RGB_Image *rgb = new Fl_RGB_Image( OffScreenBuf, W, H, 4 );
-	if ( rgb )
-		rgb->draw( x_, y_ );
-	delete[] OffScreenBuf;
-	OffScreenBuf = 0;
-	delete rgb;
+	}
+	if ( AA_Canvas.frame() )
+		AA_Canvas.end_frame( AA_Threads );
+	else if ( AA_Canvas.batch() )
+		AA_Canvas.end_batch( AA_Threads );
+	AA_Canvas.draw( x_, y_ );
+	if ( !AA_Persistent && !AA_Record )
+		AA_Canvas.release();
 }
 
 static void fl_line_aa( int x0_, int y0_, int x1_, int y1_, float width_ = 1. )
 {
-	width_ == 1. ? plotLineAA( x0_, y0_, x1_, y1_ ) :
-	               plotLineWidth( x0_, y0_, x1_, y1_, width_ );
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.line( x0_, y0_, x1_, y1_, width_ );
 }
 
 static void fl_circle_aa( int x_, int y_, int r_ )
 {
-	plotCircleAA( x_, y_, r_ );
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.circle( x_, y_, r_ );
+}
+
+static void fl_circle_aa_w( int x_, int y_, int r_, float width_ )
+{
+	// (stroked circle: fl_circle_aa( x, y, r, width ) would be the ellipse)
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.circle( x_, y_, r_, width_ );
+}
+
+// (no silent conversion of a width to the ellipse height: use fl_circle_aa_w)
+static void fl_circle_aa( int, int, int, float ) = delete;
+
+static void fl_line_aa_f( float x0_, float y0_, float x1_, float y1_, float width_ = 1. )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.line_f( x0_, y0_, x1_, y1_, width_ );
+}
+
+static void fl_circle_aa_f( float x_, float y_, float r_, float width_ = 1. )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.circle_f( x_, y_, r_, width_ );
 }
 
-static void fl_circle_aa( int x_, int y_, int w_, int h_ )
+static void fl_circle_aa( int x_, int y_, int w_, int h_, float width_ = 1. )
 {
-	w_ == h_ ? plotCircleAA( x_ + w_ / 2, y_ + h_ / 2, w_ / 2 ) :
-	           plotEllipseRectAA( x_, y_, x_ +  w_ - 1, y_ + h_ - 1 );
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.ellipse( x_, y_, w_, h_, width_ );
 }
 
 static void fl_pie_aa( int x_, int y_, int r_ )
 {
-	plotFilledCircleAA( x_, y_, r_ );
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.pie( x_, y_, r_ );
 }
 
 static void fl_pie_aa( int x_, int y_, int w_, int h_ )
 {
-	w_ == h_ ? plotFilledCircleAA( x_ + w_ / 2, y_ + h_ / 2, w_ / 2 ) :
-	           plotFilledEllipseRectAA( x_, y_, x_ + w_ - 1, y_ + h_ - 1 );
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.pie( x_, y_, w_, h_ );
+}
+
+static void fl_bezier_aa( int x0_, int y0_, int x1_, int y1_, int x2_, int y2_ )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.bezier( x0_, y0_, x1_, y1_, x2_, y2_ );
+}
+
+static void fl_bezier_aa( int x0_, int y0_, int x1_, int y1_, int x2_, int y2_, float w_, float width_ = 1. )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.bezier( x0_, y0_, x1_, y1_, x2_, y2_, w_, width_ );
+}
+
+static void fl_bezier_aa( int x0_, int y0_, int x1_, int y1_, int x2_, int y2_, int x3_, int y3_, float width_ = 1. )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.bezier( x0_, y0_, x1_, y1_, x2_, y2_, x3_, y3_, width_ );
+}
+
+static void fl_rotated_ellipse_aa( int x_, int y_, int a_, int b_, float angle_, float width_ = 1. )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.rotated_ellipse( x_, y_, a_, b_, angle_, width_ );
+}
+
+static void fl_spline_aa( const int *xy_, int n_, int degree_ = 3 )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.spline( xy_, n_, degree_ );
+}
+
+static void fl_polyline_aa( const int *xy_, int n_, float width_ = 1. )
+{
+	AA_Canvas.color( fl_color() );
+	AA_Canvas.polyline( xy_, n_, width_ );
 }
 
 #endif
@@ -0,0 +1,193 @@
+/*
+	Headless benchmark of the rasterizers of contrib/bresenham.c and
+	contrib/bresenham_ext.c (no FLTK, no display needed):
+
+	Each algorithm draws into a memory coverage buffer for some size
+	classes (line length, radius) at varying positions and angles.
+	Reported are the primitives and the pixels (setPixel/setPixelAA
+	calls and pixels of setHLine rows) per second.
+
+	Usage: bresenham_bench [--csv|--json] [seconds per test]
+	(make bench runs it with CSV output)
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <climits>
+
+static const int W = 1200;
+static const int H = 1200;
+static unsigned char Buf[W * H];	// max. coverage of each pixel
+static long long Pixels = 0;	// pixels drawn
+
+static void setPixelAA( int x, int y, unsigned char alpha )
+{
+	Pixels++;
+	if ( x < 0 || y < 0 || x >= W || y >= H )
+		return;
+	unsigned char &p = Buf[y * W + x];
+	p = std::max( p, (unsigned char)( 255 - alpha ) );
+}
+
+static void setPixel( int x, int y )
+{
+	setPixelAA( x, y, 0 );
+}
+
+static void setHLine( int x0, int x1, int y )
+{
+	Pixels += x1 - x0 + 1;
+	if ( y < 0 || y >= H )
+		return;
+	x0 = std::max( x0, 0 );
+	x1 = std::min( x1, W - 1 );
+	if ( x0 <= x1 )
+		memset( Buf + y * W + x0, 255, x1 - x0 + 1 );
+}
+
+#include "contrib/bresenham.c"
+#include "contrib/bresenham_ext.c"
+
+// primitive i of size s_ (line length/diameter) around the buffer center
+typedef void ( *Draw )( int i_, int s_ );
+
+static const int Variants = 64;
+
+static void variant( int i_, int s_, int &x0_, int &y0_, int &x1_, int &y1_ )
+{
+	// end points of a line through all octants, shifted a little
+	double a = ( i_ % Variants ) * 2 * acos( -1. ) / Variants + .1;
+	int cx = W / 2 + i_ % 7;
+	int cy = H / 2 + i_ % 5;
+	int dx = (int)floor( cos( a ) * s_ / 2 + .5 );
+	int dy = (int)floor( sin( a ) * s_ / 2 + .5 );
+	x0_ = cx - dx;
+	y0_ = cy - dy;
+	x1_ = cx + dx;
+	y1_ = cy + dy;
+}
+
+static void line_aa( int i_, int s_ )
+{
+	int x0, y0, x1, y1;
+	variant( i_, s_, x0, y0, x1, y1 );
+	plotLineAA( x0, y0, x1, y1 );
+}
+
+static void line_width( int i_, int s_ )
+{
+	int x0, y0, x1, y1;
+	variant( i_, s_, x0, y0, x1, y1 );
+	plotLineWidth( x0, y0, x1, y1, 4 );
+}
+
+static void circle_aa( int i_, int s_ )
+{
+	plotCircleAA( W / 2 + i_ % 7, H / 2 + i_ % 5, s_ / 2 );
+}
+
+static void ellipse_aa( int i_, int s_ )
+{
+	int x = W / 2 + i_ % 7 - s_ / 2;
+	int y = H / 2 + i_ % 5 - s_ / 4;
+	plotEllipseRectAA( x, y, x + s_, y + s_ / 2 );
+}
+
+static void filled_circle( int i_, int s_ )
+{
+	plotFilledCircle( W / 2 + i_ % 7, H / 2 + i_ % 5, s_ / 2 );
+}
+
+static void filled_circle_aa( int i_, int s_ )
+{
+	plotFilledCircleAA( W / 2 + i_ % 7, H / 2 + i_ % 5, s_ / 2 );
+}
+
+static void filled_ellipse_aa( int i_, int s_ )
+{
+	int x = W / 2 + i_ % 7 - s_ / 2;
+	int y = H / 2 + i_ % 5 - s_ / 4;
+	plotFilledEllipseRectAA( x, y, x + s_, y + s_ / 2 );
+}
+
+static double now()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+int main( int argc_, char *argv_[] )
+{
+	static const struct { const char *name; Draw draw; } algos[] =
+	{
+		{ "plotLineAA", line_aa },
+		{ "plotLineWidth", line_width },
+		{ "plotCircleAA", circle_aa },
+		{ "plotEllipseRectAA", ellipse_aa },
+		{ "plotFilledCircle", filled_circle },
+		{ "plotFilledCircleAA", filled_circle_aa },
+		{ "plotFilledEllipseRectAA", filled_ellipse_aa },
+	};
+	static const int sizes[] = { 8, 64, 512 };
+
+	bool json = false;
+	double seconds = .2;
+	for ( int i = 1; i < argc_; i++ )
+	{
+		if ( !strcmp( argv_[i], "--json" ) )
+			json = true;
+		else if ( !strcmp( argv_[i], "--csv" ) )
+			json = false;
+		else if ( atof( argv_[i] ) > 0 )
+			seconds = atof( argv_[i] );
+		else
+		{
+			fprintf( stderr, "usage: %s [--csv|--json] [seconds per test]\n", argv_[0] );
+			return 1;
+		}
+	}
+
+	if ( json )
+		printf( "[\n" );
+	else
+		printf( "algorithm,size,primitives,pixels,seconds,primitives_per_s,mpixels_per_s\n" );
+	bool first = true;
+	for ( size_t a = 0; a < sizeof( algos ) / sizeof( algos[0] ); a++ )
+		for ( size_t s = 0; s < sizeof( sizes ) / sizeof( sizes[0] ); s++ )
+		{
+			// draw in rounds until the time is up
+			int size = sizes[s];
+			long long prims = 0;
+			Pixels = 0;
+			double start = now(), t;
+			int round = std::max( 1, 200000 / ( size * size ) );
+			do
+			{
+				for ( int i = 0; i < round; i++ )
+					algos[a].draw( (int)( prims + i ), size );
+				prims += round;
+			}
+			while ( ( t = now() - start ) < seconds );
+
+			if ( json )
+				printf( "%s  { \"algorithm\": \"%s\", \"size\": %d, \"primitives\": %lld, \"pixels\": %lld, "
+				        "\"seconds\": %.4f, \"primitives_per_s\": %.0f, \"mpixels_per_s\": %.2f }",
+				        first ? "" : ",\n", algos[a].name, size, prims, Pixels, t, prims / t, Pixels / t / 1e6 );
+			else
+				printf( "%s,%d,%lld,%lld,%.4f,%.0f,%.2f\n",
+				        algos[a].name, size, prims, Pixels, t, prims / t, Pixels / t / 1e6 );
+			first = false;
+			fflush( stdout );
+		}
+	if ( json )
+		printf( "\n]\n" );
+
+	// (keep the buffer alive)
+	long sum = 0;
+	for ( int i = 0; i < W * H; i += 97 )
+		sum += Buf[i];
+	return sum < 0;
+}
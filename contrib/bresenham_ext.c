@@ -1,13 +1,16 @@
 /*
    extension to bresenham.c for filled circles/ellipses
    wcout 2018/03/25
+
+   interiors are filled with setHLine(x0, x1, y) (x0 <= x1), which
+   must be provided besides setPixel/setPixelAA
 */
 void plotFilledCircle(int xm, int ym, int r)
 {
    int x = -r, y = 0, err = 2-2*r;                /* bottom left to top right */
    do {
-      plotLine(xm-x, ym+y, xm+x, ym+y);                /*   I. Quadrant +x +y */
-      plotLine(xm+x, ym-y, xm-x, ym-y);                /* III. Quadrant -x -y */
+      setHLine(xm+x, xm-x, ym+y);                      /*   I. Quadrant +x +y */
+      setHLine(xm+x, xm-x, ym-y);                      /* III. Quadrant -x -y */
       r = err;
       if (r <= y) err += ++y*2+1;                             /* e_xy+e_y < 0 */
       if (r > x || err > y)                  /* e_xy+e_x > 0 or no 2nd y-step */
@@ -15,43 +18,107 @@ void plotFilledCircle(int xm, int ym, int r)
    } while (x < 0);
 }
 
-void plotFilledCircleAA(int xm, int ym, int r)
-{                     /* draw a black anti-aliased circle on white background */
-   int XM = xm;
-   int YM = ym;
-   int R = r;
-   int x = -r, y = 0;           /* II. quadrant from bottom left to top right */
-   int i, x2, e2, err = 2-2*r;                             /* error of 1.step */
-   r = 1-err;
-   do {
-      i = 255*abs(err-2*(x+y)-2)/r;               /* get blend value of pixel */
-      setPixelAA(xm-x, ym+y, i);                             /*   I. Quadrant */
-      setPixelAA(xm-y, ym-x, i);                             /*  II. Quadrant */
-      setPixelAA(xm+x, ym-y, i);                             /* III. Quadrant */
-      setPixelAA(xm+y, ym+x, i);                             /*  IV. Quadrant */
-      e2 = err; x2 = x;                                    /* remember values */
-      if (err+y > 0) {                                              /* x step */
-         i = 255*(err-2*x-1)/r;                              /* outward pixel */
-         if (i < 256) {
-            setPixelAA(xm-x, ym+y+1, i);
-            setPixelAA(xm-y-1, ym-x, i);
-            setPixelAA(xm+x, ym-y-1, i);
-            setPixelAA(xm+y+1, ym+x, i);
-         }
-         err += ++x*2+1;
-      }
-      if (e2+x2 <= 0) {                                             /* y step */
-         i = 255*(2*y+3-e2)/r;                                /* inward pixel */
-         if (i < 256) {
-            setPixelAA(xm-x2-1, ym+y, i);
-            setPixelAA(xm-y, ym-x2-1, i);
-            setPixelAA(xm+x2+1, ym-y, i);
-            setPixelAA(xm+y, ym+x2+1, i);
+static double ellipseDist(double u, double v, double a, double b)
+{ /* approx. distance of point u/v to ellipse with radii a/b (< 0: inside) */
+   double g = u*u/(a*a)+v*v/(b*b), gr, dx, dy;
+
+   if (a == b) return sqrt(u*u+v*v)-a;                      /* circle: exact */
+   if (g >= 1) {                   /* outside: normalized radius by gradient */
+      gr = sqrt(u*u/(a*a*a*a)+v*v/(b*b*b*b));                      /* length */
+      dx = std::max(fabs(u)-a, 0.0); dy = std::max(fabs(v)-b, 0.0);
+      g = sqrt(g);                        /* (at least distance to the box) */
+      return std::max(g*(g-1)/gr, sqrt(dx*dx+dy*dy));
+   }
+   dx = a*sqrt(1-v*v/(b*b))-fabs(u);  /* inside: to chord between horizontal */
+   dy = b*sqrt(1-u*u/(a*a))-fabs(v);                    /* and vertical hits */
+   return dx*dy > 0 ? -dx*dy/sqrt(dx*dx+dy*dy) : 0;
+}
+
+static void fillPixelAA(int x, int y, int i, int cx0, int cy0, int cx1, int cy1)
+{                                                    /* clipped setPixelAA */
+   if (x >= cx0 && x <= cx1 && y >= cy0 && y <= cy1) setPixelAA(x, y, i);
+}
+
+static void fillPixel4AA(int x0, int y0, int x1, int y1, int i,
+                         int cx0, int cy0, int cx1, int cy1)
+{                /* pixel mirrored into the 4 quadrants, each position once */
+   fillPixelAA(x0, y0, i, cx0, cy0, cx1, cy1);
+   if (x1 != x0) fillPixelAA(x1, y0, i, cx0, cy0, cx1, cy1);
+   if (y1 == y0) return;
+   fillPixelAA(x0, y1, i, cx0, cy0, cx1, cy1);
+   if (x1 != x0) fillPixelAA(x1, y1, i, cx0, cy0, cx1, cy1);
+}
+
+static void fillRow(int x0, int x1, int y, int cx0, int cy0, int cx1, int cy1)
+{                                                       /* clipped setHLine */
+   if (y < cy0 || y > cy1) return;
+   x0 = std::max(x0, cx0); x1 = std::min(x1, cx1);
+   if (x0 <= x1) setHLine(x0, x1, y);
+}
+
+static void plotFilledEllipseAA(int x0, int y0, int x1, int y1,
+                                int cx0, int cy0, int cx1, int cy1)
+{  /* anti-aliased filled ellipse enclosed by the rectangle, edge half a pixel
+      outside the pixel centers, each pixel plotted once: the edge walk of
+      plotEllipseRectAA plots the pixels outside the curve by their error,
+      the inside of each row is filled by setHLine when the row is left */
+   long a = abs(x1-x0), b = abs(y1-y0), b1 = b&1;                 /* diameter */
+   float dx = 4*(a-1.0)*b*b, dy = 4*(b1+1)*a*a;            /* error increment */
+   float ed, i, err = b1*a*a-dx+dy;                        /* error of 1.step */
+   int xs = INT_MAX;                           /* first inside pixel of row */
+   bool f;
+
+   if (x0 > x1) { x0 = x1; x1 += a; }        /* if called with swapped points */
+   if (y0 > y1) y0 = y1;                                  /* .. exchange them */
+   if (a == 0 || b == 0) {                           /* degenerated: solid */
+      for (y1 = y0+b; y0 <= y1; y0++) fillRow(x0, x1, y0, cx0, cy0, cx1, cy1);
+      return;
+   }
+   y0 += (b+1)/2; y1 = y0-b1;                               /* starting pixel */
+   a = 8*a*a; b1 = 8*b*b;
+
+   for (;;) {                             /* approximate ed=sqrt(dx*dx+dy*dy) */
+      i = std::min(dx,dy); ed = std::max(dx,dy);
+      if (y0 == y1+1 && err > dy && a > b1) ed = 255*4./a;           /* x-tip */
+      else ed = 255/(ed+2*ed*i*i/(4*ed*ed+i*i));             /* approximation */
+      i = err+dx-dy;                          /* pixel error, > 0: outside */
+      if (i > 0) fillPixel4AA(x0, y0, x1, y1, ed*i, cx0, cy0, cx1, cy1);
+      else if (xs == INT_MAX) xs = x0;                 /* inside: solid row */
+      if ((f = 2*err+dy >= 0)) {                /* x step, remember condition */
+         if (x0+1 >= x1) break;          /* (stop before x0/x1 cross over) */
+         i = ed*(err+dx);                         /* outward pixel: outside */
+         if (i < 255) fillPixel4AA(x0, y0+1, x1, y1-1, i, cx0, cy0, cx1, cy1);
+      }
+      if (2*err <= dx) {               /* y step: inward pixel is inside too */
+         xs = std::min(xs, x0+1);
+         fillRow(xs, x0+x1-xs, y0, cx0, cy0, cx1, cy1);
+         if (y1 != y0) fillRow(xs, x0+x1-xs, y1, cx0, cy0, cx1, cy1);
+         xs = INT_MAX;
+         y0++; y1--; err += dy += a;
+      }
+      if (f) { x0++; x1--; err -= dx -= b1; }            /* x error increment */
+   }
+   if (xs != INT_MAX) {                                        /* last row */
+      fillRow(xs, x0+x1-xs, y0, cx0, cy0, cx1, cy1);
+      if (y1 != y0) fillRow(xs, x0+x1-xs, y1, cx0, cy0, cx1, cy1);
+   }
+   if (x0+1 == x1)                         /* too early stop of flat ellipses */
+      while (y0-y1 < b) {                         /* -> finish tip of ellipse */
+         i = err+dx; y0++; y1--;                /* (error of outward pixel) */
+         if (i > 0) {
+            i = 255*4*i/b1;
+            fillPixel4AA(x0, y0, x1, y1, i, cx0, cy0, cx1, cy1);
+         } else {
+            fillRow(x0, x1, y0, cx0, cy0, cx1, cy1);
+            fillRow(x0, x1, y1, cx0, cy0, cx1, cy1);
          }
-         err += ++y*2+1;
+         err += dy += a;
       }
-   } while (x < 0);
-   plotFilledCircle(XM, YM, R);
+}
+
+void plotFilledCircleAA(int xm, int ym, int r)
+{                                         /* anti-aliased filled circle */
+   plotFilledEllipseAA(xm-r, ym-r, xm+r, ym+r, INT_MIN, INT_MIN, INT_MAX, INT_MAX);
 }
 
 void plotFilledEllipse(int xm, int ym, int a, int b)
@@ -60,8 +127,8 @@ void plotFilledEllipse(int xm, int ym, int a, int b)
    long e2 = (long)b*b, err = (long)x*(2*e2+x)+e2;         /* error of 1.step */
 
    do {
-       plotLine(xm-x, ym+y, xm+x,ym+y);                      /*   I. Quadrant */
-       plotLine(xm-x, ym-y, xm+x, ym-y);                     /*  IV. Quadrant */
+       setHLine(xm+x, xm-x, ym+y);                           /*   I. Quadrant */
+       setHLine(xm+x, xm-x, ym-y);                           /*  IV. Quadrant */
        e2 = 2*err;
        if (e2 >= (x*2+1)*(long)b*b)                           /* e_xy+e_x > 0 */
           err += (++x*2+1)*(long)b*b;
@@ -87,8 +154,8 @@ void plotFilledEllipseRect(int x0, int y0, int x1, int y1)
    a = 8*a*a; b1 = 8*b*b;
 
    do {
-      plotLine(x1, y0, x0, y0);                              /*   I. Quadrant */
-      plotLine(x1, y1, x0, y1);                              /*  IV. Quadrant */
+      setHLine(x0, x1, y0);                                  /*   I. Quadrant */
+      setHLine(x0, x1, y1);                                  /*  IV. Quadrant */
       int e2 = 2*err;
       if (e2 <= dy) { y0++; y1--; err += dy += a; }                 /* y step */
       if (e2 >= dx || 2*err > dy) { x0++; x1--; err += dx += b1; }  /* x step */
@@ -103,54 +170,722 @@ void plotFilledEllipseRect(int x0, int y0, int x1, int y1)
 }
 
 void plotFilledEllipseRectAA(int x0, int y0, int x1, int y1)
-{        /* draw a black anti-aliased rectangular ellipse on white background */
-	int X0 = x0;
-	int Y0 = y0;
-	int X1 = x1;
-	int Y1 = y1;
+{                    /* anti-aliased filled ellipse enclosed by rectangle */
+   plotFilledEllipseAA(x0, y0, x1, y1, INT_MIN, INT_MIN, INT_MAX, INT_MAX);
+}
+
+void plotQuadBezierAA(int x0, int y0, int x1, int y1, int x2, int y2)
+{                            /* plot any anti-aliased quadratic Bezier curve */
+   int x = x0-x1, y = y0-y1;
+   double t = x0-2*x1+x2, r;
+
+   if ((long)x*(x2-x1) > 0) {                        /* horizontal cut at P4? */
+      if ((long)y*(y2-y1) > 0)                     /* vertical cut at P6 too? */
+         if (fabs((y0-2*y1+y2)/t*x) > abs(y)) {               /* which first? */
+            x0 = x2; x2 = x+x1; y0 = y2; y2 = y+y1;            /* swap points */
+         }                            /* now horizontal cut at P4 comes first */
+      t = (x0-x1)/t;
+      r = (1-t)*((1-t)*y0+2.0*t*y1)+t*t*y2;                       /* By(t=P4) */
+      t = (x0*x2-x1*x1)*t/(x0-x1);                       /* gradient dP4/dx=0 */
+      x = floor(t+0.5); y = floor(r+0.5);
+      r = (y1-y0)*(t-x0)/(x1-x0)+y0;                  /* intersect P3 | P0 P1 */
+      plotQuadBezierSegAA(x0,y0, x,floor(r+0.5), x,y);
+      r = (y1-y2)*(t-x2)/(x1-x2)+y2;                  /* intersect P4 | P1 P2 */
+      x0 = x1 = x; y0 = y; y1 = floor(r+0.5);             /* P0 = P4, P1 = P8 */
+   }
+   if ((long)(y0-y1)*(y2-y1) > 0) {                    /* vertical cut at P6? */
+      t = y0-2*y1+y2; t = (y0-y1)/t;
+      r = (1-t)*((1-t)*x0+2.0*t*x1)+t*t*x2;                       /* Bx(t=P6) */
+      t = (y0*y2-y1*y1)*t/(y0-y1);                       /* gradient dP6/dy=0 */
+      x = floor(r+0.5); y = floor(t+0.5);
+      r = (x1-x0)*(t-y0)/(y1-y0)+x0;                  /* intersect P6 | P0 P1 */
+      plotQuadBezierSegAA(x0,y0, floor(r+0.5),y, x,y);
+      r = (x1-x2)*(t-y2)/(y1-y2)+x2;                  /* intersect P7 | P1 P2 */
+      x0 = x; x1 = floor(r+0.5); y0 = y1 = y;             /* P0 = P6, P1 = P7 */
+   }
+   plotQuadBezierSegAA(x0,y0, x1,y1, x2,y2);                /* remaining part */
+}
+
+void plotQuadRationalBezierAA(int x0, int y0, int x1, int y1,
+                              int x2, int y2, float w)
+{              /* plot any anti-aliased quadratic rational Bezier curve */
+   int x = x0-2*x1+x2, y = y0-2*y1+y2;
+   double xx = x0-x1, yy = y0-y1, ww, t, q;
+
+   assert(w >= 0.0);
+
+   if (xx*(x2-x1) > 0) {                             /* horizontal cut at P4? */
+      if (yy*(y2-y1) > 0)                          /* vertical cut at P6 too? */
+         if (fabs(xx*y) > fabs(yy*x)) {                       /* which first? */
+            x0 = x2; x2 = xx+x1; y0 = y2; y2 = yy+y1;          /* swap points */
+         }                            /* now horizontal cut at P4 comes first */
+      if (x0 == x2 || w == 1.0) t = (x0-x1)/(double)x;
+      else {                                 /* non-rational or rational case */
+         q = sqrt(4.0*w*w*(x0-x1)*(x2-x1)+(x2-x0)*(long)(x2-x0));
+         if (x1 < x0) q = -q;
+         t = (2.0*w*(x0-x1)-x0+x2+q)/(2.0*(1.0-w)*(x2-x0));        /* t at P4 */
+      }
+      q = 1.0/(2.0*t*(1.0-t)*(w-1.0)+1.0);                 /* sub-divide at t */
+      xx = (t*t*(x0-2.0*w*x1+x2)+2.0*t*(w*x1-x0)+x0)*q;               /* = P4 */
+      yy = (t*t*(y0-2.0*w*y1+y2)+2.0*t*(w*y1-y0)+y0)*q;
+      ww = t*(w-1.0)+1.0; ww *= ww*q;                    /* squared weight P3 */
+      w = ((1.0-t)*(w-1.0)+1.0)*sqrt(q);                         /* weight P8 */
+      x = floor(xx+0.5); y = floor(yy+0.5);                             /* P4 */
+      yy = (xx-x0)*(y1-y0)/(x1-x0)+y0;                /* intersect P3 | P0 P1 */
+      plotQuadRationalBezierSegAA(x0,y0, x,floor(yy+0.5), x,y, ww);
+      yy = (xx-x2)*(y1-y2)/(x1-x2)+y2;                /* intersect P4 | P1 P2 */
+      y1 = floor(yy+0.5); x0 = x1 = x; y0 = y;            /* P0 = P4, P1 = P8 */
+   }
+   if ((y0-y1)*(long)(y2-y1) > 0) {                    /* vertical cut at P6? */
+      if (y0 == y2 || w == 1.0) t = (y0-y1)/(y0-2.0*y1+y2);
+      else {                                 /* non-rational or rational case */
+         q = sqrt(4.0*w*w*(y0-y1)*(y2-y1)+(y2-y0)*(long)(y2-y0));
+         if (y1 < y0) q = -q;
+         t = (2.0*w*(y0-y1)-y0+y2+q)/(2.0*(1.0-w)*(y2-y0));        /* t at P6 */
+      }
+      q = 1.0/(2.0*t*(1.0-t)*(w-1.0)+1.0);                 /* sub-divide at t */
+      xx = (t*t*(x0-2.0*w*x1+x2)+2.0*t*(w*x1-x0)+x0)*q;               /* = P6 */
+      yy = (t*t*(y0-2.0*w*y1+y2)+2.0*t*(w*y1-y0)+y0)*q;
+      ww = t*(w-1.0)+1.0; ww *= ww*q;                    /* squared weight P5 */
+      w = ((1.0-t)*(w-1.0)+1.0)*sqrt(q);                         /* weight P7 */
+      x = floor(xx+0.5); y = floor(yy+0.5);                             /* P6 */
+      xx = (x1-x0)*(yy-y0)/(y1-y0)+x0;                /* intersect P6 | P0 P1 */
+      plotQuadRationalBezierSegAA(x0,y0, floor(xx+0.5),y, x,y, ww);
+      xx = (x1-x2)*(yy-y2)/(y1-y2)+x2;                /* intersect P7 | P1 P2 */
+      x1 = floor(xx+0.5); x0 = x; y0 = y1 = y;            /* P0 = P6, P1 = P7 */
+   }
+   plotQuadRationalBezierSegAA(x0,y0, x1,y1, x2,y2, w*w);        /* remaining */
+}
+
+void plotRotatedEllipseRectAA(int x0, int y0, int x1, int y1, long zd)
+{  /* anti-aliased ellipse in rectangle, integer rotation angle */
+   int xd = x1-x0, yd = y1-y0;
+   float w = xd*(long)yd;
+   if (zd == 0) return plotEllipseRectAA(x0,y0, x1,y1);        /* looks nicer */
+   if (w != 0.0) w = (w-zd)/(w+w);                    /* squared weight of P1 */
+   assert(w <= 1.0 && w >= 0.0);                /* limit angle to |zd|<=xd*yd */
+   xd = floor(xd*w+0.5); yd = floor(yd*w+0.5);           /* snap xe,ye to int */
+   plotQuadRationalBezierSegAA(x0,y0+yd, x0,y0, x0+xd,y0, 1.0-w);
+   plotQuadRationalBezierSegAA(x0,y0+yd, x0,y1, x1-xd,y1, w);
+   plotQuadRationalBezierSegAA(x1,y1-yd, x1,y1, x1-xd,y1, 1.0-w);
+   plotQuadRationalBezierSegAA(x1,y1-yd, x1,y0, x0+xd,y0, w);
+}
+
+void plotRotatedEllipseAA(int x, int y, int a, int b, float angle)
+{                   /* anti-aliased ellipse rotated by angle (radian) */
+   float xd = (long)a*a, yd = (long)b*b;
+   float s = sin(angle), zd = (xd-yd)*s;                  /* ellipse rotation */
+   xd = sqrt(xd-zd*s), yd = sqrt(yd+zd*s);           /* surrounding rectangle */
+   a = xd+0.5; b = yd+0.5; zd = zd*a*b/(xd*yd);           /* scale to integer */
+   plotRotatedEllipseRectAA(x-a,y-b, x+a,y+b, (long)(4*zd*cos(angle)));
+}
+
+void plotCubicBezierAA(int x0, int y0, int x1, int y1,
+                       int x2, int y2, int x3, int y3)
+{                               /* plot any anti-aliased cubic Bezier curve */
+   int n = 0, i = 0;
+   long xc = x0+x1-x2-x3, xa = xc-4*(x1-x2);
+   long xb = x0-x1-x2+x3, xd = xb+4*(x1+x2);
+   long yc = y0+y1-y2-y3, ya = yc-4*(y1-y2);
+   long yb = y0-y1-y2+y3, yd = yb+4*(y1+y2);
+   float fx0 = x0, fx1, fx2, fx3, fy0 = y0, fy1, fy2, fy3;
+   double t1 = xb*xb-xa*xc, t2, t[5];
+                                 /* sub-divide curve at gradient sign changes */
+   if (xa == 0) {                                               /* horizontal */
+      if (abs(xc) < 2*abs(xb)) t[n++] = xc/(2.0*xb);            /* one change */
+   } else if (t1 > 0.0) {                                      /* two changes */
+      t2 = sqrt(t1);
+      t1 = (xb-t2)/xa; if (fabs(t1) < 1.0) t[n++] = t1;
+      t1 = (xb+t2)/xa; if (fabs(t1) < 1.0) t[n++] = t1;
+   }
+   t1 = yb*yb-ya*yc;
+   if (ya == 0) {                                                 /* vertical */
+      if (abs(yc) < 2*abs(yb)) t[n++] = yc/(2.0*yb);            /* one change */
+   } else if (t1 > 0.0) {                                      /* two changes */
+      t2 = sqrt(t1);
+      t1 = (yb-t2)/ya; if (fabs(t1) < 1.0) t[n++] = t1;
+      t1 = (yb+t2)/ya; if (fabs(t1) < 1.0) t[n++] = t1;
+   }
+   for (i = 1; i < n; i++)                         /* bubble sort of 4 points */
+      if ((t1 = t[i-1]) > t[i]) { t[i-1] = t[i]; t[i] = t1; i = 0; }
+
+   t1 = -1.0; t[n] = 1.0;                                /* begin / end point */
+   for (i = 0; i <= n; i++) {                 /* plot each segment separately */
+      t2 = t[i];                                /* sub-divide at t[i-1], t[i] */
+      fx1 = (t1*(t1*xb-2*xc)-t2*(t1*(t1*xa-2*xb)+xc)+xd)/8-fx0;
+      fy1 = (t1*(t1*yb-2*yc)-t2*(t1*(t1*ya-2*yb)+yc)+yd)/8-fy0;
+      fx2 = (t2*(t2*xb-2*xc)-t1*(t2*(t2*xa-2*xb)+xc)+xd)/8-fx0;
+      fy2 = (t2*(t2*yb-2*yc)-t1*(t2*(t2*ya-2*yb)+yc)+yd)/8-fy0;
+      fx0 -= fx3 = (t2*(t2*(3*xb-t2*xa)-3*xc)+xd)/8;
+      fy0 -= fy3 = (t2*(t2*(3*yb-t2*ya)-3*yc)+yd)/8;
+      x3 = floor(fx3+0.5); y3 = floor(fy3+0.5);        /* scale bounds to int */
+      if (fx0 != 0.0) { fx1 *= fx0 = (x0-x3)/fx0; fx2 *= fx0; }
+      if (fy0 != 0.0) { fy1 *= fy0 = (y0-y3)/fy0; fy2 *= fy0; }
+      if (x0 != x3 || y0 != y3)                            /* segment t1 - t2 */
+         plotCubicBezierSegAA(x0,y0, x0+fx1,y0+fy1, x0+fx2,y0+fy2, x3,y3);
+      x0 = x3; y0 = y3; fx0 = fx3; fy0 = fy3; t1 = t2;
+   }
+}
+
+void plotQuadSplineAA(int n, int x[], int y[])
+{          /* plot anti-aliased quadratic spline, destroys input arrays x,y */
+   #define M_MAX 6
+   float mi = 1, m[M_MAX];                    /* diagonal constants of matrix */
+   int i, x0, y0, x1, y1, x2 = x[n], y2 = y[n];
+
+   assert(n > 1);                        /* need at least 3 points P[0]..P[n] */
+
+   x[1] = x0 = 8*x[1]-2*x[0];                          /* first row of matrix */
+   y[1] = y0 = 8*y[1]-2*y[0];
+
+   for (i = 2; i < n; i++) {                                 /* forward sweep */
+      if (i-2 < M_MAX) m[i-2] = mi = 1.0/(6.0-mi);
+      x[i] = x0 = floor(8*x[i]-x0*mi+0.5);                        /* store yi */
+      y[i] = y0 = floor(8*y[i]-y0*mi+0.5);
+   }
+   x1 = floor((x0-2*x2)/(5.0-mi)+0.5);                 /* correction last row */
+   y1 = floor((y0-2*y2)/(5.0-mi)+0.5);
+
+   for (i = n-2; i > 0; i--) {                           /* back substitution */
+      if (i <= M_MAX) mi = m[i-1];
+      x0 = floor((x[i]-x1)*mi+0.5);                            /* next corner */
+      y0 = floor((y[i]-y1)*mi+0.5);
+      plotQuadBezierAA((x0+x1)/2,(y0+y1)/2, x1,y1, x2,y2);
+      x2 = (x0+x1)/2; x1 = x0;
+      y2 = (y0+y1)/2; y1 = y0;
+   }
+   plotQuadBezierAA(x[0],y[0], x1,y1, x2,y2);
+}
+
+void plotCubicSplineAA(int n, int x[], int y[])
+{              /* plot anti-aliased cubic spline, destroys input arrays x,y */
+   #define M_MAX 6
+   float mi = 0.25, m[M_MAX];                 /* diagonal constants of matrix */
+   int x3 = x[n-1], y3 = y[n-1], x4 = x[n], y4 = y[n];
+   int i, x0, y0, x1, y1, x2, y2;
+
+   assert(n > 2);                        /* need at least 4 points P[0]..P[n] */
+
+   x[1] = x0 = 12*x[1]-3*x[0];                         /* first row of matrix */
+   y[1] = y0 = 12*y[1]-3*y[0];
+
+   for (i = 2; i < n; i++) {                                /* foreward sweep */
+      if (i-2 < M_MAX) m[i-2] = mi = 0.25/(2.0-mi);
+      x[i] = x0 = floor(12*x[i]-2*x0*mi+0.5);
+      y[i] = y0 = floor(12*y[i]-2*y0*mi+0.5);
+   }
+   x2 = floor((x0-3*x4)/(7-4*mi)+0.5);                    /* correct last row */
+   y2 = floor((y0-3*y4)/(7-4*mi)+0.5);
+   plotCubicBezierAA(x3,y3, (x2+x4)/2,(y2+y4)/2, x4,y4, x4,y4);
+
+   if (n-3 < M_MAX) mi = m[n-3];
+   x1 = floor((x[n-2]-2*x2)*mi+0.5);
+   y1 = floor((y[n-2]-2*y2)*mi+0.5);
+   for (i = n-3; i > 0; i--) {                           /* back substitution */
+      if (i <= M_MAX) mi = m[i-1];
+      x0 = floor((x[i]-2*x1)*mi+0.5);
+      y0 = floor((y[i]-2*y1)*mi+0.5);
+      x4 = floor((x0+4*x1+x2+3)/6.0);                     /* reconstruct P[i] */
+      y4 = floor((y0+4*y1+y2+3)/6.0);
+      plotCubicBezierAA(x4,y4,
+                        floor((2*x1+x2)/3+0.5),floor((2*y1+y2)/3+0.5),
+                        floor((x1+2*x2)/3+0.5),floor((y1+2*y2)/3+0.5),
+                        x3,y3);
+      x3 = x4; y3 = y4; x2 = x1; y2 = y1; x1 = x0; y1 = y0;
+   }
+   x0 = x[0]; x4 = floor((3*x0+7*x1+2*x2+6)/12.0);        /* reconstruct P[1] */
+   y0 = y[0]; y4 = floor((3*y0+7*y1+2*y2+6)/12.0);
+   plotCubicBezierAA(x4,y4, floor((2*x1+x2)/3+0.5),floor((2*y1+y2)/3+0.5),
+                     floor((x1+2*x2)/3+0.5),floor((y1+2*y2)/3+0.5), x3,y3);
+   plotCubicBezierAA(x0,y0, x0,y0, (x0+x1)/2,(y0+y1)/2, x4,y4);
+}
+
+/*
+   clipped variants of the line and circle/ellipse algorithms
+   (cx0,cy0)-(cx1,cy1) is the (inclusive) clip rectangle
+
+   The line and circle loops are started at the first step that can plot
+   a pixel inside the clip rectangle and stopped after the last one. The
+   loop state at that step is computed directly from the (integer) error
+   terms, so exactly the same pixels as from the unclipped algorithm are
+   plotted inside the clip rectangle.
+   The ellipse loop accumulates float error terms (which round differently
+   than computing them for a step would), so it is run from the start,
+   but only plots near the clip rectangle.
+*/
+static long long floorDiv(long long a, long long b)
+{                                              /* floor(a/b) for b > 0 */
+   return a >= 0 ? a/b : -((b-1-a)/b);
+}
+
+static long long lineMinorSteps(long long k, long long dx, long long dy)
+{          /* minor steps of the line loop before major step k, err=dx-dy */
+   if (k == 0) return 0;                              /* (also single dot) */
+   if (dx >= dy)                 /* x major: err in (-dy/2, dx-dy/2] stays */
+      return floorDiv(-dy-2*(dx-dy-k*dy), 2*dx)+1;
+   return floorDiv(2*(dx-dy+k*dx)-dx, 2*dy)+1;     /* y major: [dx/2-dy,dx/2) */
+}
+
+static bool lineClipSteps(int x0, int y0, int x1, int y1, long long dx, long long dy,
+                          int m, int mn, int cx0, int cy0, int cx1, int cy1,
+                          long long *k0, long long *k1)
+{   /* range k0..k1 of major steps that may plot inside the clip rectangle,
+       m/mn: max. distance of the plotted pixels from the loop position
+       in major/minor direction */
+   bool xm = dx >= dy;
+   int a0 = xm ? x0 : y0, a1 = xm ? x1 : y1, b0 = xm ? y0 : x0, b1 = xm ? y1 : x1;
+   int ca0 = xm ? cx0 : cy0, ca1 = xm ? cx1 : cy1;
+   int cb0 = xm ? cy0 : cx0, cb1 = xm ? cy1 : cx1;
+   long long n = abs(a1-a0), lo, hi, mid, j0, j1;
+
+   if (dx == 0 && dy == 0)                                    /* single dot */
+      return (*k0 = *k1 = 0, x0 >= cx0-m && x0 <= cx1+m && y0 >= cy0-m && y0 <= cy1+m);
+   *k0 = a0 <= a1 ? ca0-m-a0 : a0-ca1-m;                 /* major direction */
+   *k1 = a0 <= a1 ? ca1+m-a0 : a0-ca0+m;
+   *k0 = std::max(*k0, 0LL); *k1 = std::min(*k1, n);
+   if (*k0 > *k1) return false;
+   j0 = b0 <= b1 ? cb0-mn-b0 : b0-cb1-mn;                /* minor direction */
+   j1 = b0 <= b1 ? cb1+mn-b0 : b0-cb0+mn;
+   if (lineMinorSteps(*k0, dx, dy) < j0) {        /* search first step >= j0 */
+      for (lo = *k0, hi = *k1+1; lo < hi; )
+         if (lineMinorSteps(mid = (lo+hi)/2, dx, dy) < j0) lo = mid+1; else hi = mid;
+      *k0 = lo;
+   }
+   if (lineMinorSteps(*k1, dx, dy) > j1) {         /* search last step <= j1 */
+      for (lo = *k0-1, hi = *k1; lo < hi; )
+         if (lineMinorSteps(mid = (lo+hi+1)/2, dx, dy) > j1) hi = mid-1; else lo = mid;
+      *k1 = lo;
+   }
+   return *k0 <= *k1;
+}
+
+void plotLineAAClip(int x0, int y0, int x1, int y1, int cx0, int cy0, int cx1, int cy1)
+{                                         /* clipped anti-aliased line */
+   int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1, x2;
+   long dx = abs(x1-x0), dy = abs(y1-y0), err = dx*dx+dy*dy;
+   long e2 = err == 0 ? 1 : 0xffff7fl/sqrt(err);     /* multiplication factor */
+   long long k, k1, j;
+
+   dx *= e2; dy *= e2; err = dx-dy;                       /* error value e_xy */
+   if (!lineClipSteps(x0,y0, x1,y1, dx,dy, 1,1, cx0,cy0,cx1,cy1, &k,&k1)) return;
+   j = lineMinorSteps(k, dx, dy);                    /* jump to first step */
+   if (dx >= dy) { x0 += sx*k; y0 += sy*j; err += j*dx-k*dy; }
+   else          { y0 += sy*k; x0 += sx*j; err += k*dx-j*dy; }
+   for ( ; ; k++) {                                             /* pixel loop */
+      setPixelAA(x0,y0,abs(err-dx+dy)>>16);
+      e2 = err; x2 = x0;
+      if (2*e2 >= -dx) {                                            /* x step */
+         if (x0 == x1) break;
+         if (e2+dy < 0xff0000l) setPixelAA(x0,y0+sy,(e2+dy)>>16);
+         err -= dy; x0 += sx;
+      }
+      if (2*e2 <= dy) {                                             /* y step */
+         if (y0 == y1) break;
+         if (dx-e2 < 0xff0000l) setPixelAA(x2+sx,y0,(dx-e2)>>16);
+         err += dx; y0 += sy;
+      }
+      if (k == k1) break;                           /* left clip rectangle */
+   }
+}
+
+void plotLineWidthClip(int x0, int y0, int x1, int y1, float wd,
+                       int cx0, int cy0, int cx1, int cy1)
+{                      /* clipped anti-aliased line of width wd */
+   int dx = abs(x1-x0), sx = x0 < x1 ? 1 : -1;
+   int dy = abs(y1-y0), sy = y0 < y1 ? 1 : -1;
+   int err = dx-dy, e2, x2, y2;                           /* error value e_xy */
+   float ed = dx+dy == 0 ? 1 : sqrt((float)dx*dx+(float)dy*dy);
+   int ma = std::min(dx,dy), mb = std::max(dx,dy);   /* max. run lengths.. */
+   long long k, k1, j;
+
+   wd = (wd+1)/2;
+   ma = ma ? ed*wd/ma+2 : 2;                          /* ..along major axis */
+   mb = mb ? ed*wd/mb+2 : 2;                         /* ..perpendicular to it */
+   if (!lineClipSteps(x0,y0, x1,y1, dx,dy, ma,mb, cx0,cy0,cx1,cy1, &k,&k1)) return;
+   j = lineMinorSteps(k, dx, dy);                    /* jump to first step */
+   if (dx >= dy) { x0 += sx*k; y0 += sy*j; err += j*dx-k*dy; }
+   else          { y0 += sy*k; x0 += sx*j; err += k*dx-j*dy; }
+   for ( ; ; k++) {                                             /* pixel loop */
+      setPixelAA(x0, y0, std::max(0,(int)(255*(abs(err-dx+dy)/ed-wd+1))));
+      e2 = err; x2 = x0;
+      if (2*e2 >= -dx) {                                            /* x step */
+         for (e2 += dy, y2 = y0; e2 < ed*wd && (y1 != y2 || dx > dy); e2 += dx)
+            setPixelAA(x0, y2 += sy, std::max(0,(int)(255*(abs(e2)/ed-wd+1))));
+         if (x0 == x1) break;
+         e2 = err; err -= dy; x0 += sx;
+      }
+      if (2*e2 <= dy) {                                             /* y step */
+         for (e2 = dx-e2; e2 < ed*wd && (x1 != x2 || dx < dy); e2 += dy)
+            setPixelAA(x2 += sx, y0, std::max(0,(int)(255*(abs(e2)/ed-wd+1))));
+         if (y0 == y1) break;
+         err += dx; y0 += sy;
+      }
+      if (k == k1) break;                           /* left clip rectangle */
+   }
+}
+
+static long long circleXStep(long long x, long long y, long long r)
+{                 /* circle loop does an x step at x/y if result > 0 */
+   return (x+1)*(x+1)+(y+1)*(y+1)+y-r*r;
+}
+
+static long long circleYStep(long long x, long long y, long long r)
+{                 /* circle loop does a y step at x/y if result <= 0 */
+   return (x+1)*(x+1)+x+(y+1)*(y+1)-r*r;
+}
+
+static bool circleRowStart(int r, int y, int *x)
+{  /* first x of row y of the circle loop (valid in the flat octant only) */
+   long long t = floor((-3-sqrt(std::max(0.0, 5.0-4.0*((double)y*y-(double)r*r))))/2);
+   while (t > -r && circleYStep(t-1, y-1, r) <= 0) t--;         /* exact.. */
+   while (t < 0 && circleYStep(t, y-1, r) > 0) t++;         /* ..last x of y-1 */
+   *x = t+(circleXStep(t, y-1, r) > 0);
+   return -*x > y+1;
+}
+
+static bool circleColStart(int r, int x, int *y)
+{ /* first y of column x of the circle loop (valid in the steep octant only) */
+   long long p = x-1;
+   long long u = ceil((-3+sqrt(std::max(0.0, 9.0-4.0*(2.0+(double)(p+1)*(p+1)-(double)r*r))))/2);
+   u = std::max(u, 0LL);
+   while (u > 0 && circleXStep(p, u-1, r) > 0) u--;             /* exact.. */
+   while (circleXStep(p, u, r) <= 0) u++;                /* ..last y of x-1 */
+   *y = u+(circleYStep(p, u, r) <= 0);
+   return -x+1 <= *y;
+}
+
+static void circleStep(int *x, int *y, int *err)
+{                                     /* one step of the circle loop */
+   int e2 = *err, x2 = *x;
+   if (*err+*y > 0) *err += ++*x*2+1;
+   if (e2+x2 <= 0) *err += ++*y*2+1;
+}
+
+static void circleFirstY(int r, int ya, int *x, int *y, int *err)
+{                        /* first position of the circle loop with y >= ya */
+   int t, c;
+   *x = -r; *y = 0;
+   if (ya > 0 && circleRowStart(r, ya, &t)) { *x = t; *y = ya; }  /* flat */
+   else if (ya > 0) {                       /* steep: anchor at a column */
+      c = -(int)ceil(sqrt(std::max(0.0, (double)r*r-(double)ya*ya)))-1;
+      if (c > -r && circleColStart(r, c, &t) && t < ya) { *x = c; *y = t; }
+      else for (t = ya-1; t > 0; t--)          /* diagonal: at a flat row */
+         if (circleRowStart(r, t, &c)) { *x = c; *y = t; break; }
+   }
+   *err = (*x+1)*(*x+1)+(*y+1)*(*y+1)-r*r;
+   while (*x < 0 && *y < ya) circleStep(x, y, err);                  /* walk */
+}
+
+static void circleFirstX(int r, int xa, int *x, int *y, int *err)
+{                        /* first position of the circle loop with x >= xa */
+   int t, c;
+   *x = -r; *y = 0;
+   if (xa > -r && circleColStart(r, xa, &t)) { *x = xa; *y = t; } /* steep */
+   else if (xa > -r) {                          /* flat: anchor at a row */
+      for (c = (int)sqrt(std::max(0.0, (double)r*r-(double)xa*xa))-1; c > 0; c--)
+         if (circleRowStart(r, c, &t) && t < xa) { *x = t; *y = c; break; }
+   }
+   *err = (*x+1)*(*x+1)+(*y+1)*(*y+1)-r*r;
+   while (*x < 0 && *x < xa) circleStep(x, y, err);                  /* walk */
+}
+
+void plotCircleAAClip(int xm, int ym, int r, int cx0, int cy0, int cx1, int cy1)
+{                                  /* clipped anti-aliased circle */
+   int x, y, i, x2, e2, err, rr = 2*r-1, n = 0, s, q, t;
+   int seg[4][5];    /* visible parts of the quadrants in loop coordinates */
+   int rc[4][4] = {                           /* x/y ranges of the quadrants */
+      { xm-cx1-1, xm-cx0+1, cy0-1-ym, cy1+1-ym },        /*   I: xm-x, ym+y */
+      { ym-cy1-1, ym-cy0+1, xm-cx1-1, xm-cx0+1 },        /*  II: xm-y, ym-x */
+      { cx0-1-xm, cx1+1-xm, ym-cy1-1, ym-cy0+1 },        /* III: xm+x, ym-y */
+      { cy0-1-ym, cy1+1-ym, cx0-1-xm, cx1+1-xm } };      /*  IV: xm+y, ym+x */
+
+   if (xm+r < cx0-1 || xm-r > cx1+1 || ym+r < cy0-1 || ym-r > cy1+1) return;
+   if ((xm-r > cx0 && xm+r < cx1 && ym-r > cy0 && ym+r < cy1) || r <= 0)
+      return plotCircleAA(xm, ym, r);                 /* completely inside */
+   for (q = 0; q < 4; q++) {                  /* entry points of quadrants */
+      int xa = std::max(rc[q][0], -r), xb = std::min(rc[q][1], 0);
+      int ya = std::max(rc[q][2], 0), yb = std::min(rc[q][3], r);
+      if (xa > xb || ya > yb) continue;
+      circleFirstX(r, xa, &x, &y, &err);
+      circleFirstY(r, ya, &x2, &e2, &i);
+      if (x2+e2 > x+y) { x = x2; y = e2; }                    /* later one */
+      if (x >= 0 || x > xb || y > yb) continue;
+      for (s = n++; s > 0 && seg[s-1][0]+seg[s-1][1] > x+y; s--)      /* sort */
+         for (t = 0; t < 5; t++) seg[s][t] = seg[s-1][t];
+      seg[s][0] = x; seg[s][1] = y; seg[s][2] = xb; seg[s][3] = yb;
+   }
+   for (x = y = 1, s = 0; s < n; s++) {     /* each loop position only once */
+      if (x > 0 || seg[s][0]+seg[s][1] > x+y) {
+         x = seg[s][0]; y = seg[s][1]; err = (x+1)*(x+1)+(y+1)*(y+1)-r*r;
+      }
+      while (x < 0 && x <= seg[s][2] && y <= seg[s][3]) {   /* circle loop */
+         i = 255*abs(err-2*(x+y)-2)/rr;              /* get blend value of pixel */
+         setPixelAA(xm-x, ym+y, i);                               /*   I. Quadrant */
+         setPixelAA(xm-y, ym-x, i);                               /*  II. Quadrant */
+         setPixelAA(xm+x, ym-y, i);                               /* III. Quadrant */
+         setPixelAA(xm+y, ym+x, i);                               /*  IV. Quadrant */
+         e2 = err; x2 = x;                                    /* remember values */
+         if (err+y > 0) {                                              /* x step */
+            i = 255*(err-2*x-1)/rr;                              /* outward pixel */
+            if (i < 256) {
+               setPixelAA(xm-x, ym+y+1, i);
+               setPixelAA(xm-y-1, ym-x, i);
+               setPixelAA(xm+x, ym-y-1, i);
+               setPixelAA(xm+y+1, ym+x, i);
+            }
+            err += ++x*2+1;
+         }
+         if (e2+x2 <= 0) {                                             /* y step */
+            i = 255*(2*y+3-e2)/rr;                                /* inward pixel */
+            if (i < 256) {
+               setPixelAA(xm-x2-1, ym+y, i);
+               setPixelAA(xm-y, ym-x2-1, i);
+               setPixelAA(xm+x2+1, ym-y, i);
+               setPixelAA(xm+y, ym+x2+1, i);
+            }
+            err += ++y*2+1;
+         }
+      }
+   }
+}
+
+void plotEllipseRectAAClip(int x0, int y0, int x1, int y1,
+                           int cx0, int cy0, int cx1, int cy1)
+{ /* clipped anti-aliased ellipse: the loop of plotEllipseRectAA, plotting
+     only near the clip rectangle and stopped when it has left it for good */
    long a = abs(x1-x0), b = abs(y1-y0), b1 = b&1;                 /* diameter */
    float dx = 4*(a-1.0)*b*b, dy = 4*(b1+1)*a*a;            /* error increment */
-   float ed, i, err = b1*a*a-dx+dy;                        /* error of 1.step */
-	bool f;
+   float ed = 0, i, err = b1*a*a-dx+dy;                    /* error of 1.step */
+   bool f, v;
 
+   if (std::max(x0,x1) < cx0-1 || std::min(x0,x1) > cx1+1 ||
+       std::max(y0,y1) < cy0-1 || std::min(y0,y1) > cy1+1) return;
+   if (std::min(x0,x1) > cx0 && std::max(x0,x1) < cx1 &&
+       std::min(y0,y1) > cy0 && std::max(y0,y1) < cy1)
+      return plotEllipseRectAA(x0, y0, x1, y1);           /* completely inside */
    if (a == 0 || b == 0) return plotLine(x0,y0, x1,y1);
    if (x0 > x1) { x0 = x1; x1 += a; }        /* if called with swapped points */
    if (y0 > y1) y0 = y1;                                  /* .. exchange them */
    y0 += (b+1)/2; y1 = y0-b1;                               /* starting pixel */
    a = 8*a*a; b1 = 8*b*b;
 
-   for (;;) {                             /* approximate ed=sqrt(dx*dx+dy*dy) */
-      i = std::min(dx,dy); ed = std::max(dx,dy);
-      if (y0 == y1+1 && err > dy && a > b1) ed = 255*4./a;           /* x-tip */
-      else ed = 255/(ed+2*ed*i*i/(4*ed*ed+i*i));             /* approximation */
-      i = ed*fabs(err+dx-dy);           /* get intensity value by pixel error */
-      setPixelAA(x0,y0, i); setPixelAA(x0,y1, i);
-      setPixelAA(x1,y0, i); setPixelAA(x1,y1, i);
-
-      if (f = 2*err+dy >= 0) {                  /* x step, remember condition */
+   for (;;) {
+      v = ((x0 >= cx0-1 && x0 <= cx1+1) || (x1 >= cx0-1 && x1 <= cx1+1)) &&
+          ((y0 >= cy0-1 && y0 <= cy1+1) || (y1 >= cy0-1 && y1 <= cy1+1));
+      if (v) {                            /* approximate ed=sqrt(dx*dx+dy*dy) */
+         i = std::min(dx,dy); ed = std::max(dx,dy);
+         if (y0 == y1+1 && err > dy && a > b1) ed = 255*4./a;        /* x-tip */
+         else ed = 255/(ed+2*ed*i*i/(4*ed*ed+i*i));          /* approximation */
+         i = ed*fabs(err+dx-dy);        /* get intensity value by pixel error */
+         setPixelAA(x0,y0, i); setPixelAA(x0,y1, i);
+         setPixelAA(x1,y0, i); setPixelAA(x1,y1, i);
+      }
+      if ((f = 2*err+dy >= 0)) {                /* x step, remember condition */
          if (x0 >= x1) break;
          i = ed*(err+dx);
-         if (i < 255) {
+         if (v && i < 255) {
             setPixelAA(x0,y0+1, i); setPixelAA(x0,y1-1, i);
             setPixelAA(x1,y0+1, i); setPixelAA(x1,y1-1, i);
          }          /* do error increment later since values are still needed */
       }
       if (2*err <= dx) {                                            /* y step */
          i = ed*(dy-err);
-         if (i < 255) {
+         if (v && i < 255) {
             setPixelAA(x0+1,y0, i); setPixelAA(x1-1,y0, i);
             setPixelAA(x0+1,y1, i); setPixelAA(x1-1,y1, i);
          }
          y0++; y1--; err += dy += a;
       }
       if (f) { x0++; x1--; err -= dx -= b1; }            /* x error increment */
+      if ((x0 > cx1+1 && x1 < cx0-1) || (y0 > cy1+1 && y1 < cy0-1))
+         return;                       /* outside for good: x0,y0 only grow */
    }
-   if (--x0 == x1++)                       /* too early stop of flat ellipses */
-      while (y0-y1 < b) {
+   if (--x0 == x1++ && x1 >= cx0 && x0 <= cx1)   /* too early stop of flat */
+      while (y0-y1 < b && (y0 < cy1 || y1 > cy0)) {       /* ellipses */
          i = 255*4*fabs(err+dx)/b1;               /* -> finish tip of ellipse */
          setPixelAA(x0,++y0, i); setPixelAA(x1,y0, i);
          setPixelAA(x0,--y1, i); setPixelAA(x1,y1, i);
          err += dy += a;
       }
-   plotFilledEllipseRect(X0, Y0, X1, Y1);
+}
+
+void plotFilledCircleAAClip(int xm, int ym, int r, int cx0, int cy0, int cx1, int cy1)
+{                              /* clipped anti-aliased filled circle */
+   plotFilledEllipseAA(xm-r, ym-r, xm+r, ym+r, cx0, cy0, cx1, cy1);
+}
+
+void plotFilledEllipseRectAAClip(int x0, int y0, int x1, int y1,
+                                 int cx0, int cy0, int cx1, int cy1)
+{                    /* clipped anti-aliased filled rectangular ellipse */
+   plotFilledEllipseAA(x0, y0, x1, y1, cx0, cy0, cx1, cy1);
+}
+
+/*
+   subpixel variants: all coordinates and radii are 24.8 fixed point
+   values (pixel x covers x-0.5..x+0.5, like the integer functions),
+   (cx0,cy0)-(cx1,cy1) is the (inclusive) clip rectangle in pixels
+*/
+static void setPixelAASwap(int x, int y, int alpha, bool swap)
+{                                      /* plot pixel with exchanged x/y */
+   if (swap) setPixelAA(y, x, alpha); else setPixelAA(x, y, alpha);
+}
+
+void plotLineAAFixed(int x0, int y0, int x1, int y1,
+                     int cx0, int cy0, int cx1, int cy1)
+{       /* anti-aliased line with subpixel end points, two pixels a column */
+   bool swap = abs(y1-y0) > abs(x1-x0);
+   int dx, dy, x, xe, a, c, f;
+   long long y, py, g;
+
+   if (swap) {                        /* y major: walk rows instead of columns */
+      std::swap(x0, y0); std::swap(x1, y1);
+      std::swap(cx0, cy0); std::swap(cx1, cy1);
+   }
+   if (x0 > x1) { std::swap(x0, x1); std::swap(y0, y1); }
+   dx = x1-x0; dy = y1-y0;
+   x = floorDiv(x0+128, 256); xe = floorDiv(x1+128, 256);  /* end columns */
+   if (dx == 0) {                                 /* no length: single dot */
+      py = floorDiv(y0+128, 256);
+      if (x >= cx0 && x <= cx1 && py >= cy0 && py <= cy1) setPixelAA(x, py, 0);
+      return;
+   }
+   g = dy*65536LL/dx;                                       /* slope (16.16) */
+   c = 256*dx/sqrt((double)dx*dx+(double)dy*dy);  /* y distance -> normal */
+   x = std::max(x, cx0); xe = std::min(xe, cx1);
+   y = y0*65536LL+(long long)(x*256-x0)*g;                /* y at column x */
+   for ( ; x <= xe; x++, y += g*256) {
+      a = std::min(x1, x*256+128)-std::max(x0, x*256-128); /* column part */
+      if (a <= 0) continue;
+      py = floorDiv(y, 1LL<<24);                      /* upper pixel row */
+      f = (y-py*(1LL<<24))>>16;              /* y fraction in pixel units */
+      f = (256-(f*c>>8))*a>>8;                       /* coverage upper pixel */
+      if (py >= cy0 && py <= cy1)
+         setPixelAASwap(x, py, 255-std::min(f, 255), swap);
+      f = (y-py*(1LL<<24))>>16;
+      f = (256-((256-f)*c>>8))*a>>8;                 /* coverage lower pixel */
+      if (py+1 >= cy0 && py+1 <= cy1 && f > 0)
+         setPixelAASwap(x, py+1, 255-std::min(f, 255), swap);
+   }
+}
+
+void plotLineWidthFixed(int x0, int y0, int x1, int y1, float wd,
+                        int cx0, int cy0, int cx1, int cy1)
+{ /* anti-aliased line of width wd with subpixel end points, butt ends */
+   bool swap = abs(y1-y0) > abs(x1-x0);
+   float fx0, fy0, fx1, fy1, dx, dy, ed, nx, ny, hv, s, t, i;
+   int x, xe, y, ye;
+
+   if (swap) {                        /* y major: walk rows instead of columns */
+      std::swap(x0, y0); std::swap(x1, y1);
+      std::swap(cx0, cy0); std::swap(cx1, cy1);
+   }
+   if (x0 > x1) { std::swap(x0, x1); std::swap(y0, y1); }
+   fx0 = x0/256.f; fy0 = y0/256.f; fx1 = x1/256.f; fy1 = y1/256.f;
+   dx = fx1-fx0; dy = fy1-fy0; ed = sqrt(dx*dx+dy*dy);
+   if (dx <= 0) return;                                         /* no length */
+   nx = -dy/ed; ny = dx/ed;                       /* unit normal of the line */
+   wd /= 2; hv = (wd+1)/ny;            /* half width, half column height */
+   x = std::max((int)floor(fx0-wd*fabsf(nx)-1), cx0);
+   xe = std::min((int)ceil(fx1+wd*fabsf(nx)+1), cx1);
+   for ( ; x <= xe; x++) {                                     /* column loop */
+      s = fy0+(x-fx0)*dy/dx;                          /* line center at x */
+      y = std::max((int)floor(s-hv), cy0); ye = std::min((int)ceil(s+hv), cy1);
+      s = (x-fx0)*nx+(y-fy0)*ny;                 /* distance from the line */
+      t = (x-fx0)*ny-(y-fy0)*nx;           /* and position along it at x/y */
+      for ( ; y <= ye; y++, s += ny, t -= nx) {
+         i = std::min(wd+0.5f-fabsf(s), std::min(t+0.5f, ed+0.5f-t));
+         if (i > 0) setPixelAASwap(x, y, 255-(int)(255*std::min(i, 1.f)), swap);
+      }
+   }
+}
+
+void plotCircleAAFixed(int xm, int ym, int r, int cx0, int cy0, int cx1, int cy1)
+{     /* anti-aliased circle with subpixel center and radius, one pixel wide */
+   long long u, v, d, r2 = (long long)r*r, e2 = 512LL*std::max(r, 128);
+   double fx = xm/256., fy = ym/256., fr = r/256., ro, ri;
+   int x, xe, y, ye, i, n;
+
+   y = std::max((int)floor(fy-fr-1), cy0); ye = std::min((int)ceil(fy+fr+1), cy1);
+   for ( ; y <= ye; y++) {                                        /* row loop */
+      ro = (fr+1)*(fr+1)-(y-fy)*(y-fy);                  /* outer/inner edge */
+      ri = fr > 1 ? (fr-1)*(fr-1)-(y-fy)*(y-fy) : -1;     /* of ring in row */
+      if (ro <= 0) continue;
+      for (n = ri > 0 ? 2 : 1; n-- > 0; ) {                 /* left/right run */
+         x = ceil(fx-sqrt(ro)); xe = floor(fx+sqrt(ro));
+         if (ri > 0) {
+            if (n) xe = floor(fx-sqrt(ri)); else x = ceil(fx+sqrt(ri));
+         }
+         x = std::max(x, cx0); xe = std::min(xe, cx1);
+         u = x*256LL-xm; v = y*256LL-ym;
+         d = u*u+v*v-r2;                       /* squared distance - radius² */
+         for ( ; x <= xe; x++) {
+            i = 255-(long long)255*(d < 0 ? -d : d)/e2;  /* 1-|d|/2r coverage */
+            if (i > 0) setPixelAA(x, y, 255-i);
+            d += 512*u+65536; u += 256;
+         }
+      }
+   }
+}
+
+void plotCircleWidthFixed(int xm, int ym, int r, float wd,
+                          int cx0, int cy0, int cx1, int cy1)
+{  /* anti-aliased circle of width wd with subpixel center and radius */
+   double fx = xm/256., fy = ym/256., fr = r/256., h = wd/2.;
+   double ro = fr+h+0.5, ri = fr-h-0.5;      /* radii enclosing ring and hole */
+   double v, d, eo, ei;
+   int x, xe, xn, y, ye, n;
+
+   y = std::max((int)ceil(fy-ro), cy0); ye = std::min((int)floor(fy+ro), cy1);
+   for ( ; y <= ye; y++) {                                        /* row loop */
+      v = (y-fy)*(y-fy);
+      if (v >= ro*ro) continue;
+      eo = sqrt(ro*ro-v);                          /* outer half row width */
+      ei = ri > 0 && v < ri*ri ? sqrt(ri*ri-v) : -1;  /* hole half width or -1 */
+      xn = (int)ceil(fx-eo);                       /* first unplotted pixel */
+      for (n = ei < 0 ? 1 : 2; n-- > 0; ) {                /* left/right run */
+         x = std::max(xn, cx0);
+         xe = (int)floor(n ? fx-ei : fx+eo);
+         if (ei >= 0 && !n) x = std::max(x, (int)ceil(fx+ei));
+         xn = xe+1;                               /* no pixel plotted twice */
+         for (xe = std::min(xe, cx1); x <= xe; x++) {
+            d = h+0.5-fabs(sqrt((x-fx)*(x-fx)+v)-fr);             /* coverage */
+            if (d > 0) setPixelAA(x, y, 255-(int)(255*std::min(d, 1.0)));
+         }
+      }
+   }
+}
+
+/*
+   thick outlines: ring of width wd around an ellipse, scanned row by row
+*/
+void plotEllipseRectWidthClip(int x0, int y0, int x1, int y1, float wd,
+                              int cx0, int cy0, int cx1, int cy1)
+{ /* anti-aliased ellipse outline of width wd inside rectangle (centerline) */
+   double xm = (x0+x1)/2.0, ym = (y0+y1)/2.0;                  /* center */
+   double a = std::max(abs(x1-x0)/2.0, 0.5), b = std::max(abs(y1-y0)/2.0, 0.5);
+   double h = wd/2.0, r = h+1, m = std::min(a, b);      /* half width, margin */
+   double so = 1+r/m, si = 1-r/m;       /* ellipses enclosing ring and hole */
+   double v, d, eo, ei;
+   int x, xe, xn, y, ye, n;
+
+   y = std::max((int)floor(ym-b-r), cy0); ye = std::min((int)ceil(ym+b+r), cy1);
+   for ( ; y <= ye; y++) {                                        /* row loop */
+      v = y-ym;
+      eo = 1-v*v/(b*so*b*so);
+      if (eo <= 0) continue;
+      eo = std::min(a*so*sqrt(eo), a+r);           /* outer half row width */
+      ei = si > 0 ? 1-v*v/(b*si*b*si) : 0;
+      ei = ei > 0 ? a*si*sqrt(ei) : -1;         /* hole half row width or -1 */
+      xn = (int)floor(xm-eo);                      /* first unplotted pixel */
+      for (n = ei < 0 ? 1 : 2; n-- > 0; ) {                /* left/right run */
+         x = std::max(xn, cx0);
+         xe = (int)ceil(n ? xm-ei : xm+eo);
+         if (ei >= 0 && !n) x = std::max(x, (int)floor(xm+ei));
+         xn = xe+1;                               /* no pixel plotted twice */
+         for (xe = std::min(xe, cx1); x <= xe; x++) {
+            d = h+0.5-fabs(ellipseDist(x-xm, v, a, b));           /* coverage */
+            if (d > 0) setPixelAA(x, y, 255-(int)(255*std::min(d, 1.0)));
+         }
+      }
+   }
 }
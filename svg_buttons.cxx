@@ -3,7 +3,8 @@
 	Test usage of SVG images to draw buttons with
 	gradient/roundness/borderwidth.
 
-	SVG images are created "on the fly".
+	SVG images are created "on the fly" (parsed and rasterized by
+	Fl_SVG_Image at the pixels of the screen, see svg_raster.h).
 
 	Needs FLTK 1.4 with SVG support enabled.
 
@@ -12,9 +13,9 @@
 */
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Button.H>
-#include <FL/Fl_SVG_Image.H>
 #include <FL/fl_draw.H>
 #include <FL/Fl.H>
+#include "svg_raster.h"
 
 #include <string>
 #include <fstream>
@@ -132,14 +133,13 @@ public:
 		_up( 0 ),
 		_uphi( 0 ),
 		_down( 0 ),
-		_image( 0 )
+		_image( 0 ),
+		_stale( true )
 	{
 		labelsize( h_ / 2 );
 		callback( cb, this );
 		if ( style_ )
 			style( *style_ );
-		else
-			init_images();
 	}
 	static void cb( Fl_Widget *wgt_, void *d_ )
 	{
@@ -151,12 +151,13 @@ public:
 		// i.e. an opaque part of the image data.
 		int dx = Fl::event_x() - x();
 		int dy = Fl::event_y() - y();
-		Fl_SVG_Image *image = value() ? _down : _image;
-		if ( !image )
+		Fl_RGB_Image *image = value() ? _down : _image;
+		if ( !image || dx < 0 || dy < 0 || dx >= image->w() || dy >= image->h() )
 			return false;
-		image->resize( w(), h() ); // make sure SVG is rasterized (array is valid)
-		return ( dx >= 0 && dy >= 0 && dx < image->w() && dy < image->h() &&
-				   ( image->array[image->w() * dy * 4 + dx * 4 + 3] ) );
+		// (the image is rasterized at the screen's pixels, see svg_scale())
+		int px = dx * image->data_w() / image->w();
+		int py = dy * image->data_h() / image->h();
+		return image->array[image->data_w() * py * 4 + px * 4 + 3];
 	}
 	virtual int handle( int e_ )
 	{
@@ -198,6 +199,7 @@ public:
 		delete _uphi;
 		delete _down;
 		_up = _down = _uphi = _image = 0;
+		_stale = false;
 
 		string up_data = create_svg( w(), h(), style() );
 		string down_data = create_svg( w(), h(), style(), true );
@@ -207,55 +209,74 @@ public:
 		ofs << up_data;
 		ofs.close();
 #endif
-		_up = new Fl_SVG_Image( 0, up_data.c_str() );
-		_up->proportional = false;
-		_down = new Fl_SVG_Image( 0, down_data.c_str() );
-		_down->proportional = false;
+		_up = rasterize( up_data );
+		_down = rasterize( down_data );
+		if ( !_up || !_down )
+		{
+			delete _up;
+			delete _down;
+			_up = _down = 0;
+			return;
+		}
 		_down->color_average( FL_BLACK, 0.8 );
-		_uphi = (Fl_SVG_Image *)_up->copy();
+		_uphi = (Fl_RGB_Image *)_up->copy();
 		_uphi->color_average( FL_WHITE, 0.8 );
 		_image = _up;
 	}
 	virtual void resize( int x_, int y_, int w_, int h_ )
 	{
-		if ( !_up || ( _up && (  _up->w() != w_ || _up->h() != h_ ) ) )
+		if ( w_ != w() || h_ != h() )
 		{
 			double f = (double)h_ / h();
 			labelsize( lround( (double)labelsize() * f ) );
-			init_images();
+			_stale = true; // (rasterized at the new size by draw())
 		}
 		Inherited::resize( x_, y_, w_, h_ );
 	}
 	virtual void draw()
 	{
+		if ( _stale || ( _up && _up->data_w() != svg_pixels( w(), svg_scale( this ) ) ) )
+		{
+			// (new size or style, or screen scale changed:
+			// rasterize once for all resize() calls since the last draw)
+			bool hi = _image && _image == _uphi;
+			init_images();
+			if ( hi && _uphi )
+				_image = _uphi;
+		}
 //		fl_rectf( x(), y(), w(), h(), parent()->color() ); // HACK: get rid of minor artefacts on edges of SVG's
 		if ( value() )
 		{
-			_down->resize( w(), h() );
-			_down->draw( x(), y() );
+			if ( _down )
+				_down->draw( x(), y() );
 		}
-		else
-		{
-			_image->resize( w(), h() );
+		else if ( _image )
 			_image->draw( x(), y() );
-		}
 		draw_label( x() + value(), y() + value(), w(), h() );
 	}
 	void style( const Style& s_ )
 	{
 		_style = s_;
 		labelcolor( _style.textColor );
-		init_images();
+		_stale = true;
+		redraw();
 	}
 	const Style& style() const
 	{
 		return _style;
 	}
 private:
-	Fl_SVG_Image *_up;
-	Fl_SVG_Image *_uphi;
-	Fl_SVG_Image *_down;
-	Fl_SVG_Image *_image;
+	Fl_RGB_Image *rasterize( const string &svg_ ) const
+	{
+		// image of a SVG document (with the size of the button)
+		return svg_text_image( svg_.c_str(), w(), h(), svg_scale( this ) );
+	}
+
+	Fl_RGB_Image *_up;
+	Fl_RGB_Image *_uphi;
+	Fl_RGB_Image *_down;
+	Fl_RGB_Image *_image;
+	bool _stale;	// images need to be rasterized (by draw())
 	Style _style;
 };
 
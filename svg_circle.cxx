@@ -9,6 +9,9 @@
 
 	Speed of SVG rendering is of course way slower than FLTK drawing, but
 	it seems fair enough for rendering things that don't change very often.
+	The rasterized circles are cached, so redraws without a size change
+	just draw images (the cache statistics are printed on each click).
+	The concentric circles are batched into one SVG document.
 
 	Needs FLTK 1.4 with SVG support enabled.
 
@@ -19,6 +22,7 @@
 #include <FL/Fl_Box.H>
 #include "svg_circle.h"
 #include <cstdio>
+#include <cstring>
 
 static int USE_SVG = 1; // start in SVG mode
 
@@ -70,11 +74,14 @@ public:
 		// filled ellipse with thick outline
 		circle( x() + 60, y() + 60, w() - 120, h() - 120, 30, FL_RED, FL_GREEN );
 
-		// draw many concentric circles (speed test)
+		// draw many concentric circles (speed test),
+		// as one SVG document in SVG mode
+		fl_svg_begin_circles();
 		for ( int r = 2; r < h() / 4; r += 4 )
 		{
 			circle( x() + w() / 2 - r, y() +  h() / 2 - r, 2 * r, 2 * r, 1, FL_WHITE );
 		}
+		fl_svg_end_circles();
 	}
 	int handle( int e_ )
 	{
@@ -82,6 +89,10 @@ public:
 		int ret = Fl_Box::handle( e_ );
 		if ( e_ == FL_PUSH )
 		{
+			const SVG_Circle_Cache &cache = fl_svg_circle_cache();
+			printf( "svg circle cache: %lu hits, %lu misses (%.0f%%), %lu images, %lu bytes\n",
+			        cache.hits(), cache.misses(), cache.hit_rate() * 100,
+			        (unsigned long)cache.size(), (unsigned long)cache.bytes() );
 			USE_SVG = !USE_SVG;
 			window()->redraw();
 		}
@@ -91,6 +102,7 @@ public:
 
 int main( int argc, char **argv )
 {
+	fl_svg_circle_cache( 16 << 20 );
 	Fl_Double_Window win( 480, 480, "svg circle" );
 	Drawing d( 0, 0, win.w(), win.h() );
 	win.end();
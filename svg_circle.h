@@ -4,26 +4,64 @@
 #include <FL/Fl.H>
 #include <FL/Fl_SVG_Image.H>
 #include <FL/fl_draw.H>
+#include "svg_raster.h"
+#include <algorithm>
 #include <cstdio>
-
-static const Fl_Color Transparent = 0xffffffff; // give FLTK a definition for "transparent color"
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
 
 // helpers
+static const char *svg_ellipse( char *buf_, size_t size_,
+                                int x_, int y_, int w_, int h_,
+                                int stroke_w_,
+                                const char *stroke_color_,
+                                const char *fill_color_ )
+{
+	// ellipse element of a circle in the box x_/y_/w_/h_
+	static const char *svg_ellipse_template =
+		"<ellipse cx=\"%d\" cy=\"%d\" rx=\"%d\" ry=\"%d\" stroke-width=\"%d\" stroke=\"%s\" fill=\"%s\"/>";
+	snprintf( buf_, size_, svg_ellipse_template,
+	          x_ + w_ / 2, y_ + h_ / 2,
+	          w_ / 2 - stroke_w_, h_ / 2 - stroke_w_,
+	          stroke_w_, stroke_color_, fill_color_ );
+	return buf_;
+}
+
+static const char *svg_color( char *buf_, size_t size_, Fl_Color color_ )
+{
+	// SVG color of a FLTK color ("none" for Transparent)
+	if ( color_ == Transparent )
+		return "none";
+	uchar r, g, b;
+	Fl::get_color( color_, r, g, b );
+	snprintf( buf_, size_, "rgb(%d,%d,%d)", (int)r, (int)g, (int)b );
+	return buf_;
+}
+
+static const char *svg_circle_doc( char *buf_, size_t size_,
+                                   int w_, int h_,
+                                   int stroke_w_,
+                                   const char *stroke_color_,
+                                   const char *fill_color_ )
+{
+	// SVG document of a circle filling w_ x h_
+	char ellipse[300];
+	snprintf( buf_, size_, "<svg width=\"%d\" height=\"%d\">%s</svg>",
+	          w_, h_, svg_ellipse( ellipse, sizeof(ellipse), 0, 0, w_, h_,
+	                               stroke_w_, stroke_color_, fill_color_ ) );
+	return buf_;
+}
+
 static Fl_SVG_Image *create_svg_circle( int x_, int y_, int w_, int h_,
                                         int stroke_w_,
                                         const char *stroke_color_,
                                         const char *fill_color_ = "none" )
 {
 	char buf[500];
-	static const char *svg_circle_template =
-		"<svg width=\"%d\" height=\"%d\">"
-		"<ellipse cx=\"%d\" cy=\"%d\" rx=\"%d\" ry=\"%d\" stroke-width=\"%d\" stroke=\"%s\" fill=\"%s\"/>"
-		"</svg>";
-	snprintf( buf, sizeof(buf), svg_circle_template,
-		       w_, h_, w_/ 2, h_/ 2,
-	          w_ / 2 - stroke_w_, h_ / 2 - stroke_w_,
-	          stroke_w_, stroke_color_, fill_color_ );
-	return new Fl_SVG_Image( NULL, buf );
+	return new Fl_SVG_Image( NULL, svg_circle_doc( buf, sizeof(buf), w_, h_,
+	                                               stroke_w_, stroke_color_, fill_color_ ) );
 }
 
 static Fl_SVG_Image *create_svg_circle( int x_, int y_, int w_, int h_,
@@ -31,18 +69,207 @@ static Fl_SVG_Image *create_svg_circle( int x_, int y_, int w_, int h_,
                                         Fl_Color stroke_color_,
                                         Fl_Color fill_color_ = Transparent )
 {
-	uchar sr, sg, sb;
-	Fl::get_color( stroke_color_, sr, sg, sb );
 	char c[50];
 	char fc[50];
-	snprintf( c, sizeof(c),"rgb(%d,%d,%d)", (int)sr, (int)sg, (int)sb );
-	if ( fill_color_ != Transparent )
+	return create_svg_circle( x_, y_, w_, h_, stroke_w_, svg_color( c, sizeof(c), stroke_color_ ),
+	                          svg_color( fc, sizeof(fc), fill_color_ ) );
+}
+
+// LRU cache of rasterized circle images
+//    Keyed by size, stroke width, the rgb values of the colors (so
+//    changes of the FLTK colormap don't matter) and the screen scale the
+//    image was rasterized at (see svg_scale()). Least recently used
+//    images are deleted when the cache holds more than capacity() bytes
+//    of pixels (capacity 0: no caching).
+class SVG_Circle_Cache
+{
+public:
+	struct Key
+	{
+		int w, h, stroke_w;
+		unsigned stroke, fill;	// 0xrrggbb00, fill: Transparent for none
+		float scale;	// pixels per unit
+		bool operator<( const Key &k_ ) const
+		{
+			if ( w != k_.w ) return w < k_.w;
+			if ( h != k_.h ) return h < k_.h;
+			if ( stroke_w != k_.stroke_w ) return stroke_w < k_.stroke_w;
+			if ( stroke != k_.stroke ) return stroke < k_.stroke;
+			if ( fill != k_.fill ) return fill < k_.fill;
+			return scale < k_.scale;
+		}
+	};
+
+	SVG_Circle_Cache( size_t capacity_ = 16 << 20 ) :
+		_capacity( capacity_ ),
+		_bytes( 0 ),
+		_hits( 0 ),
+		_misses( 0 )
+	{
+	}
+	~SVG_Circle_Cache()
+	{
+		clear();
+	}
+	static Key key( int w_, int h_, int stroke_w_, Fl_Color stroke_, Fl_Color fill_, float scale_ = 1 )
+	{
+		Key k = { w_, h_, stroke_w_, rgb( stroke_ ), fill_ == Transparent ? Transparent : rgb( fill_ ), scale_ };
+		return k;
+	}
+	Fl_RGB_Image *find( const Key &k_ )
+	{
+		// cached image or 0 (counted as hit or miss)
+		std::map<Key, Lru::iterator>::iterator i = _index.find( k_ );
+		if ( i == _index.end() )
+		{
+			_misses++;
+			return 0;
+		}
+		_hits++;
+		_lru.splice( _lru.begin(), _lru, i->second );
+		return i->second->second;
+	}
+	bool insert( const Key &k_, Fl_RGB_Image *image_ )
+	{
+		// take ownership of a rasterized image, false if it doesn't fit
+		size_t n = bytes( k_ );
+		if ( n > _capacity || _index.count( k_ ) )
+			return false;
+		_lru.push_front( std::make_pair( k_, image_ ) );
+		_index[k_] = _lru.begin();
+		_bytes += n;
+		trim();
+		return true;
+	}
+	void capacity( size_t capacity_ )
+	{
+		_capacity = capacity_;
+		trim();
+	}
+	size_t capacity() const { return _capacity; }
+	void clear()
+	{
+		// delete all images and reset the counters
+		for ( Lru::iterator i = _lru.begin(); i != _lru.end(); ++i )
+			delete i->second;
+		_lru.clear();
+		_index.clear();
+		_bytes = 0;
+		_hits = _misses = 0;
+	}
+	size_t bytes() const { return _bytes; }
+	size_t size() const { return _index.size(); }
+	unsigned long hits() const { return _hits; }
+	unsigned long misses() const { return _misses; }
+	double hit_rate() const
+	{
+		return _hits + _misses ? (double)_hits / ( _hits + _misses ) : 0.;
+	}
+
+private:
+	typedef std::list<std::pair<Key, Fl_RGB_Image *> > Lru;
+	static unsigned rgb( Fl_Color c_ )
 	{
-		uchar fr, fg, fb;
-		Fl::get_color( fill_color_, fr, fg, fb );
-		snprintf( fc, sizeof(fc), "rgb(%d,%d,%d)", (int)fr, (int)fg, (int)fb );
+		uchar r, g, b;
+		Fl::get_color( c_, r, g, b );
+		return (unsigned)r << 24 | g << 16 | b << 8;
 	}
-	return create_svg_circle( x_, y_, w_, h_, stroke_w_, c, fill_color_ == Transparent ? "none" : fc );
+	static size_t bytes( const Key &k_ )
+	{
+		// (pixels of the rasterized image)
+		return (size_t)svg_pixels( k_.w, k_.scale ) * svg_pixels( k_.h, k_.scale ) * 4;
+	}
+	void trim()
+	{
+		while ( _bytes > _capacity )
+		{
+			_bytes -= bytes( _lru.back().first );
+			delete _lru.back().second;
+			_index.erase( _lru.back().first );
+			_lru.pop_back();
+		}
+	}
+
+	size_t _capacity;	// max. bytes
+	size_t _bytes;	// bytes of the cached images
+	unsigned long _hits, _misses;
+	Lru _lru;	// most recently used first
+	std::map<Key, Lru::iterator> _index;
+};
+
+static SVG_Circle_Cache SVG_Circles( 0 );
+
+static void fl_svg_circle_cache( size_t capacity_ )
+{
+	// cache rasterized circles up to capacity_ bytes (0: don't cache)
+	SVG_Circles.capacity( capacity_ );
+}
+
+static SVG_Circle_Cache &fl_svg_circle_cache()
+{
+	// (for the hit/miss counters)
+	return SVG_Circles;
+}
+
+// batching of circles
+//    Between fl_svg_begin_circles() and fl_svg_end_circles() the circles
+//    of fl_svg_circle() are collected as elements of one SVG document,
+//    which fl_svg_end_circles() rasterizes once into an image covering
+//    all of them and draws. The image is kept and drawn again as long as
+//    the same circles are drawn at the same positions.
+struct SVG_Circle_Batch
+{
+	SVG_Circle_Batch() :
+		active( false ),
+		x0( 0 ), y0( 0 ), x1( 0 ), y1( 0 ),
+		scale( 1 ),
+		image( 0 )
+	{
+	}
+	~SVG_Circle_Batch()
+	{
+		delete image;
+	}
+	bool active;
+	int x0, y0, x1, y1;	// bounding box of the circles (x1/y1 exclusive)
+	std::string ellipses;	// their elements
+	std::string doc;	// document of the last batch..
+	float scale;	// ..the scale it was rasterized at..
+	Fl_RGB_Image *image;	// ..and its image
+};
+
+static SVG_Circle_Batch SVG_Batch;
+
+static void fl_svg_begin_circles()
+{
+	SVG_Batch.active = true;
+	SVG_Batch.ellipses.clear();
+}
+
+static void fl_svg_end_circles()
+{
+	SVG_Circle_Batch &b = SVG_Batch;
+	b.active = false;
+	if ( b.ellipses.empty() )
+		return;
+	int w = b.x1 - b.x0;
+	int h = b.y1 - b.y0;
+	if ( !w || !h )
+		return;
+	char head[200];
+	snprintf( head, sizeof(head), "<svg width=\"%d\" height=\"%d\"><g transform=\"translate(%d,%d)\">",
+	          w, h, -b.x0, -b.y0 );
+	std::string doc = head + b.ellipses + "</g></svg>";
+	float scale = svg_scale();
+	if ( !b.image || doc != b.doc || scale != b.scale )
+	{
+		delete b.image;
+		b.image = svg_text_image( doc.c_str(), w, h, scale );
+		b.doc.swap( doc );
+		b.scale = scale;
+	}
+	if ( b.image )
+		b.image->draw( b.x0, b.y0 );
 }
 
 // FLTK interface hiding the implementation
@@ -53,10 +280,41 @@ static void fl_svg_circle( int x_, int y_, int w_, int h_,
 {
 	if ( w_ < 0 || h_ < 0 ) // Crashes Fl_SVG_Image::rasterize() otherwise
 		return;
-	Fl_SVG_Image *c = create_svg_circle( x_, y_, w_, h_, width_, color_, fill_color_ );
-	c->resize( w_, h_ ); // rasterize SVG
+	if ( SVG_Batch.active )
+	{
+		char ellipse[300];
+		char c[50];
+		char fc[50];
+		SVG_Circle_Batch &b = SVG_Batch;
+		b.x0 = b.ellipses.empty() ? x_ : std::min( b.x0, x_ );
+		b.y0 = b.ellipses.empty() ? y_ : std::min( b.y0, y_ );
+		b.x1 = b.ellipses.empty() ? x_ + w_ : std::max( b.x1, x_ + w_ );
+		b.y1 = b.ellipses.empty() ? y_ + h_ : std::max( b.y1, y_ + h_ );
+		b.ellipses += svg_ellipse( ellipse, sizeof(ellipse), x_, y_, w_, h_, width_,
+		                           svg_color( c, sizeof(c), color_ ), svg_color( fc, sizeof(fc), fill_color_ ) );
+		return;
+	}
+	float scale = svg_scale();
+	SVG_Circle_Cache::Key k = SVG_Circle_Cache::key( w_, h_, width_, color_, fill_color_, scale );
+	if ( SVG_Circles.capacity() )
+	{
+		if ( Fl_RGB_Image *c = SVG_Circles.find( k ) )
+		{
+			c->draw( x_, y_ );
+			return;
+		}
+	}
+	char buf[500];
+	char sc[50];
+	char fc[50];
+	Fl_RGB_Image *c = svg_text_image( svg_circle_doc( buf, sizeof(buf), w_, h_, width_,
+	                                                  svg_color( sc, sizeof(sc), color_ ),
+	                                                  svg_color( fc, sizeof(fc), fill_color_ ) ), w_, h_, scale );
+	if ( !c )
+		return;
 	c->draw( x_, y_ );
-	delete c;
+	if ( !SVG_Circles.capacity() || !SVG_Circles.insert( k, c ) )
+		delete c;
 	return;
 }
 
@@ -19,6 +19,7 @@
 #include <FL/Fl_Box.H>
 #include <FL/Fl_SVG_Image.H>
 #include <FL/Fl_Image_Surface.H>
+#include "svg_raster.h"	/* svg_text_image(): rasterized at the screen's pixels */
 
 //
 // Simplex clock simulator
@@ -787,13 +788,14 @@ public:
 		sec_deg = fmod( sec_deg, 360 );
 		sprintf( s, G_hands_svg, hour_deg, min_deg, sec_deg );	// let sprintf() expand the %.2f's embedded within
 		// Rebuild hands, reassign to box
+		//    (scaled proportionally to the box, rasterized at the screen's pixels)
+		int d = w() < h() ? w() : h();
 		delete hands_svg;
-		hands_svg = new Fl_SVG_Image( NULL, s );
-		hands_svg->scale( w(), h(), 1, 1 );
+		hands_svg = svg_text_image( s, d, d, svg_scale( this ) );
 		hands->image( hands_svg );
 		clock_svg->scale( w(), h(), /*proportional= */ 1, /*can_expand= */ 1 );
-		// No longer need copy of svg data, Fl_SVG_Image already parsed it into an image
-		delete s;
+		// No longer need copy of svg data, it's already parsed and rasterized
+		delete[] s;
 		redraw();
 	} // ShowTime
 
@@ -888,7 +890,7 @@ public:
 private:
 	// Clock face
 	Fl_SVG_Image *clock_svg;	// the svg image assigned to the clock box
-	Fl_SVG_Image *hands_svg;	// the svg image assigned to the hands box
+	Fl_RGB_Image *hands_svg;	// the rasterized svg image assigned to the hands box
 	double rate;			// timer tick rate the user specified with StartClock()
 	Fl_Box *clock;
 	Fl_Box *hands;
@@ -0,0 +1,54 @@
+#ifndef FLTK_SVG_RASTER_H
+#define FLTK_SVG_RASTER_H
+
+/*
+	Rasterize SVG text with Fl_SVG_Image at the pixels of the screen.
+
+	Images are rasterized at the pixels of the screen (w x h units times
+	svg_scale()) and scaled to be drawn w x h units (Fl_Image::scale()),
+	so they are sharp on HiDPI screens.
+*/
+#include <FL/Fl.H>
+#include <FL/Fl_RGB_Image.H>
+#include <FL/Fl_SVG_Image.H>
+#include <FL/Fl_Window.H>
+#include <cmath>
+
+static const Fl_Color Transparent = 0xffffffff; // give FLTK a definition for "transparent color"
+
+// helpers
+static float svg_scale( const Fl_Widget *widget_ = 0 )
+{
+	// pixels per FLTK unit on the screen of widget_'s window
+	// (of the current window for 0)
+	Fl_Window *win = widget_ ? widget_->top_window() : Fl_Window::current();
+	return Fl::screen_scale( win ? win->screen_num() : 0 );
+}
+
+static int svg_pixels( int units_, float scale_ )
+{
+	// (pixels of units_ at scale_)
+	return (int)lroundf( units_ * scale_ );
+}
+
+static Fl_RGB_Image *svg_text_image( const char *svg_, int w_, int h_, float scale_ = 1 )
+{
+	// image of a SVG document of w_ x h_ units drawn w_ x h_,
+	// rasterized at scale_ pixels per unit (0 if it can't be parsed)
+	int pw = svg_pixels( w_, scale_ );
+	int ph = svg_pixels( h_, scale_ );
+	if ( pw <= 0 || ph <= 0 )
+		return 0;
+	Fl_SVG_Image *rgb = new Fl_SVG_Image( NULL, svg_ );
+	if ( rgb->fail() )
+	{
+		delete rgb;
+		return 0;
+	}
+	rgb->resize( pw, ph ); // rasterize SVG
+	if ( scale_ != 1 )
+		rgb->scale( w_, h_, 0, 1 );
+	return rgb;
+}
+
+#endif